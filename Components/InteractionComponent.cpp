@@ -2,6 +2,11 @@
 
 #include "../Widgets/InteractionWidget.h"
 #include "../Player/SurvivalCharacter.h"
+#include "../World/InteractionSubsystem.h"
+#include "../Player/SurvivalPlayerController.h"
+#include "Components/WidgetComponent.h"
+#include "HAL/IConsoleManager.h"
+#include "UObject/UObjectIterator.h"
 
 UInteractionComponent::UInteractionComponent()
 {
@@ -13,13 +18,81 @@ UInteractionComponent::UInteractionComponent()
 	InteractableActionText = FText::FromString("Interact");
 	bAllowMultipleInteractors = true;
 
-	Space = EWidgetSpace::Screen;
-	DrawSize = FIntPoint(600, 100);
-	bDrawAtDesiredSize = true;
+	WidgetMode = EInteractionWidgetMode::IWM_SharedHUD;
+	WidgetDrawSize = FIntPoint(600, 100);
+	WidgetComponent = nullptr;
 
 	SetActive(true);
-	SetHiddenInGame(true);
 
+	GridCell = FIntVector::ZeroValue;
+	GridIndex = INDEX_NONE;
+
+	HighlightOwnerComponentCount = INDEX_NONE;
+	bWantsHighlight = false;
+	bHighlighted = false;
+	bHighlightQueued = false;
+}
+
+void UInteractionComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	TransformUpdated.AddUObject(this, &UInteractionComponent::OnTransformUpdated);
+	UpdateRegistration(IsActive());
+
+	// Only local players see highlights, so a dedicated server never needs these
+	if (GetNetMode() != NM_DedicatedServer)
+	{
+		CacheHighlightPrimitives();
+	}
+}
+
+void UInteractionComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Nothing calls EndFocus() on an interactable that's destroyed while focused, so take the shared prompt down ourselves
+	if (ASurvivalPlayerController* PC = SharedWidgetController.Get())
+	{
+		PC->HideInteractionWidget(this);
+		SharedWidgetController = nullptr;
+	}
+
+	UpdateRegistration(false);
+	TransformUpdated.RemoveAll(this);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UInteractionComponent::Activate(bool bReset)
+{
+	Super::Activate(bReset);
+
+	UpdateRegistration(HasBegunPlay() && IsActive());
+}
+
+void UInteractionComponent::UpdateRegistration(const bool bShouldRegister)
+{
+	if (UInteractionSubsystem* Interactions = UInteractionSubsystem::Get(this))
+	{
+		if (bShouldRegister)
+		{
+			Interactions->RegisterInteractable(this);
+		}
+		else
+		{
+			Interactions->UnregisterInteractable(this);
+		}
+	}
+}
+
+void UInteractionComponent::OnTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	if (GridIndex != INDEX_NONE)
+	{
+		if (UInteractionSubsystem* Interactions = UInteractionSubsystem::Get(this))
+		{
+			Interactions->UpdateInteractable(this);
+		}
+	}
 }
 
 void UInteractionComponent::SetInteractableNameText(const FText& NewNameText)
@@ -38,6 +111,8 @@ void UInteractionComponent::Deactivate()
 {
 	Super::Deactivate();
 
+	UpdateRegistration(false);
+
 	for (int32 i = Interactors.Num() - 1; i >= 0; --i)
 	{
 		if (ASurvivalCharacter* Interactor = Interactors[i])
@@ -52,19 +127,44 @@ void UInteractionComponent::Deactivate()
 
 bool UInteractionComponent::CanInteract(class ASurvivalCharacter* Character) const
 {
-	const bool bPlayerAlreadyInteracting = !bAllowMultipleInteractors && Interactors.Num() >= 1;
+	// Someone else is already interacting. The character's own interact shouldn't block it from completing
+	const bool bPlayerAlreadyInteracting = !bAllowMultipleInteractors && Interactors.Num() >= 1 && !Interactors.Contains(Character);
 	return !bPlayerAlreadyInteracting && IsActive() && GetOwner() != nullptr && Character != nullptr;
 }
 
 void UInteractionComponent::RefreshWidget()
 {
+	if (ASurvivalPlayerController* PC = SharedWidgetController.Get())
+	{
+		PC->RefreshInteractionWidget(this);
+	}
+
 	//Make sure the widget is initialized, and that we are displaying the right values (these may have changed)
-	if (UInteractionWidget* InteractionWidget = Cast<UInteractionWidget>(GetUserWidgetObject()))
+	if (UInteractionWidget* InteractionWidget = WidgetComponent ? Cast<UInteractionWidget>(WidgetComponent->GetUserWidgetObject()) : nullptr)
 	{
 		InteractionWidget->UpdateInteractionWidget(this);
 	}
 }
 
+class UWidgetComponent* UInteractionComponent::GetOrCreateWidgetComponent()
+{
+	if (!WidgetComponent && GetOwner() && GetNetMode() != NM_DedicatedServer)
+	{
+		WidgetComponent = NewObject<UWidgetComponent>(GetOwner(), NAME_None, RF_Transient);
+		WidgetComponent->SetWidgetSpace(EWidgetSpace::Screen);
+		WidgetComponent->SetDrawSize(WidgetDrawSize);
+		WidgetComponent->SetDrawAtDesiredSize(true);
+		WidgetComponent->SetWidgetClass(InteractionWidgetClass);
+		WidgetComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		WidgetComponent->SetHiddenInGame(true);
+		WidgetComponent->SetupAttachment(this);
+		WidgetComponent->RegisterComponent();
+		WidgetComponent->InitWidget();
+	}
+
+	return WidgetComponent;
+}
+
 void UInteractionComponent::BeginFocus(class ASurvivalCharacter* Character)
 {
 	if (!IsActive() || !GetOwner() || !Character)
@@ -74,17 +174,23 @@ void UInteractionComponent::BeginFocus(class ASurvivalCharacter* Character)
 
 	OnBeginFocus.Broadcast(Character);
 
-	if (GetNetMode() != NM_DedicatedServer)
+	// The server also focuses interactables when validating a client's interact, but only the player doing the looking needs to see anything
+	if (GetNetMode() != NM_DedicatedServer && Character->IsLocallyControlled())
 	{
-		SetHiddenInGame(false);
+		ASurvivalPlayerController* PC = WidgetMode == EInteractionWidgetMode::IWM_SharedHUD ? Cast<ASurvivalPlayerController>(Character->GetController()) : nullptr;
 
-		for (auto& VisualComp : GetOwner()->GetComponentsByClass(UPrimitiveComponent::StaticClass()))
+		if (PC)
 		{
-			if (UPrimitiveComponent* Prim = Cast<UPrimitiveComponent>(VisualComp))
-			{
-				Prim->SetRenderCustomDepth(true);
-			}
+			SharedWidgetController = PC;
+			PC->ShowInteractionWidget(this);
 		}
+		// Per interactable widgets, and shared ones when the controller has no HUD widget to share
+		else if (UWidgetComponent* Widget = GetOrCreateWidgetComponent())
+		{
+			Widget->SetHiddenInGame(false);
+		}
+
+		SetWantsHighlight(true);
 	}
 
 	RefreshWidget();
@@ -94,18 +200,111 @@ void UInteractionComponent::EndFocus(class ASurvivalCharacter* Character)
 {
 	OnEndFocus.Broadcast(Character);
 
-	if (GetNetMode() != NM_DedicatedServer)
+	if (GetNetMode() != NM_DedicatedServer && Character && Character->IsLocallyControlled())
+	{
+		if (ASurvivalPlayerController* PC = SharedWidgetController.Get())
+		{
+			PC->HideInteractionWidget(this);
+			SharedWidgetController = nullptr;
+		}
+
+		if (WidgetComponent)
+		{
+			WidgetComponent->SetHiddenInGame(true);
+		}
+
+		SetWantsHighlight(false);
+	}
+}
+
+void UInteractionComponent::SetWantsHighlight(const bool bNewWantsHighlight)
+{
+	bWantsHighlight = bNewWantsHighlight;
+
+	if (UInteractionSubsystem* Interactions = UInteractionSubsystem::Get(this))
+	{
+		Interactions->RequestHighlight(this);
+	}
+	else
+	{
+		ApplyHighlight();
+	}
+}
+
+bool UInteractionComponent::ApplyHighlight()
+{
+	if (bHighlighted == bWantsHighlight || !GetOwner())
+	{
+		return false;
+	}
+
+	bHighlighted = bWantsHighlight;
+
+	for (const TWeakObjectPtr<UPrimitiveComponent>& Prim : GetHighlightPrimitives())
+	{
+		if (Prim.IsValid())
+		{
+			Prim->SetRenderCustomDepth(bHighlighted);
+		}
+	}
+
+	return true;
+}
+
+const TArray<TWeakObjectPtr<class UPrimitiveComponent>>& UInteractionComponent::GetHighlightPrimitives()
+{
+	if (GetOwner() && GetOwner()->GetComponents().Num() != HighlightOwnerComponentCount)
+	{
+		CacheHighlightPrimitives();
+	}
+
+	return HighlightPrimitives;
+}
+
+void UInteractionComponent::CacheHighlightPrimitives()
+{
+	HighlightPrimitives.Reset();
+
+	if (AActor* Owner = GetOwner())
 	{
-		SetHiddenInGame(true);
+		HighlightOwnerComponentCount = Owner->GetComponents().Num();
 
-		for (auto& VisualComp : GetOwner()->GetComponentsByClass(UPrimitiveComponent::StaticClass()))
+		for (UActorComponent* Component : Owner->GetComponents())
 		{
-			if (UPrimitiveComponent* Prim = Cast<UPrimitiveComponent>(VisualComp))
+			// Our own prompt shouldn't be drawn into the outline
+			UPrimitiveComponent* Prim = Cast<UPrimitiveComponent>(Component);
+
+			if (Prim && Prim != WidgetComponent)
+			{
+				HighlightPrimitives.Add(Prim);
+			}
+		}
+
+		if (UInteractionSubsystem* Interactions = UInteractionSubsystem::Get(this))
+		{
+			++Interactions->NumHighlightCacheRebuilds;
+		}
+	}
+}
+
+void UInteractionComponent::InvalidateHighlightPrimitives()
+{
+	// Whatever we highlighted has to be turned off before we forget about it
+	if (bHighlighted)
+	{
+		for (const TWeakObjectPtr<UPrimitiveComponent>& Prim : HighlightPrimitives)
+		{
+			if (Prim.IsValid())
 			{
 				Prim->SetRenderCustomDepth(false);
 			}
 		}
+
+		bHighlighted = false;
+		SetWantsHighlight(bWantsHighlight);
 	}
+
+	HighlightOwnerComponentCount = INDEX_NONE;
 }
 
 void UInteractionComponent::BeginInteract(class ASurvivalCharacter* Character)
@@ -113,6 +312,21 @@ void UInteractionComponent::BeginInteract(class ASurvivalCharacter* Character)
 	if (CanInteract(Character))
 	{
 		Interactors.AddUnique(Character);
+
+		if (!FindInteractionProgress(Character))
+		{
+			FInteractionProgress Progress;
+			Progress.Interactor = Character;
+			Progress.StartTime = GetWorld()->GetTimeSeconds();
+			Progress.Duration = InteractionTime;
+			InteractionProgress.Add(Progress);
+
+			if (UInteractionWidget* InteractionWidget = GetLocalInteractionWidget(Character))
+			{
+				InteractionWidget->NotifyInteractStarted(Progress.StartTime, Progress.Duration);
+			}
+		}
+
 		OnBeginInteract.Broadcast(Character);
 	}
 }
@@ -120,6 +334,22 @@ void UInteractionComponent::BeginInteract(class ASurvivalCharacter* Character)
 void UInteractionComponent::EndInteract(class ASurvivalCharacter* Character)
 {
 	Interactors.RemoveSingle(Character);
+
+	// Still having progress means the interact never completed
+	const int32 ProgressIndex = InteractionProgress.IndexOfByPredicate([Character](const FInteractionProgress& Progress) { return Progress.Interactor == Character; });
+
+	if (ProgressIndex != INDEX_NONE)
+	{
+		InteractionProgress.RemoveAtSwap(ProgressIndex, 1, false);
+
+		if (UInteractionWidget* InteractionWidget = GetLocalInteractionWidget(Character))
+		{
+			InteractionWidget->NotifyInteractCancelled();
+		}
+
+		OnCancelInteract.Broadcast(Character);
+	}
+
 	OnEndInteract.Broadcast(Character);
 }
 
@@ -127,21 +357,82 @@ void UInteractionComponent::Interact(class ASurvivalCharacter* Character)
 {
 	if (CanInteract(Character))
 	{
+		InteractionProgress.RemoveAllSwap([Character](const FInteractionProgress& Progress) { return Progress.Interactor == Character; }, false);
+
+		if (UInteractionWidget* InteractionWidget = GetLocalInteractionWidget(Character))
+		{
+			InteractionWidget->NotifyInteractCompleted();
+		}
+
 		OnInteract.Broadcast(Character);
 	}
 }
 
-float UInteractionComponent::GetInteractPercentage()
+const FInteractionProgress* UInteractionComponent::FindInteractionProgress(const class ASurvivalCharacter* Character) const
+{
+	return InteractionProgress.FindByPredicate([Character](const FInteractionProgress& Progress) { return Progress.Interactor == Character; });
+}
+
+class UInteractionWidget* UInteractionComponent::GetLocalInteractionWidget(const class ASurvivalCharacter* Character) const
+{
+	if (!Character || !Character->IsLocallyControlled())
+	{
+		return nullptr;
+	}
+
+	if (ASurvivalPlayerController* PC = SharedWidgetController.Get())
+	{
+		return PC->GetInteractionWidget(this);
+	}
+
+	return WidgetComponent ? Cast<UInteractionWidget>(WidgetComponent->GetUserWidgetObject()) : nullptr;
+}
+
+float UInteractionComponent::GetInteractPercentage() const
+{
+	return InteractionProgress.Num() ? InteractionProgress[0].GetPercentage(GetWorld()->GetTimeSeconds()) : 0.f;
+}
+
+float UInteractionComponent::GetInteractPercentageFor(const class ASurvivalCharacter* Character) const
 {
-	if (Interactors.IsValidIndex(0))
+	const FInteractionProgress* Progress = FindInteractionProgress(Character);
+	return Progress ? Progress->GetPercentage(GetWorld()->GetTimeSeconds()) : 0.f;
+}
+
+#if !UE_BUILD_SHIPPING
+static FAutoConsoleCommandWithWorld InteractionWidgetReportCommand(
+	TEXT("SurvivalGame.Interaction.WidgetReport"),
+	TEXT("Logs how many interaction components, widget components and interaction widgets exist in the current world, and roughly how much memory they use."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
 	{
-		if (ASurvivalCharacter* Interactor = Interactors[0])
+		int32 NumInteractables = 0;
+		int32 NumSharedHUD = 0;
+		int32 NumWidgetComponents = 0;
+		int32 NumWidgets = 0;
+
+		for (TObjectIterator<UInteractionComponent> It; It; ++It)
 		{
-			if (Interactor && Interactor->IsInteracting())
+			if (It->GetWorld() == World && !It->IsTemplate())
 			{
-				return 1.f - FMath::Abs(Interactor->GetRemainingInteractTime() / InteractionTime);
+				++NumInteractables;
+				NumSharedHUD += It->WidgetMode == EInteractionWidgetMode::IWM_SharedHUD ? 1 : 0;
 			}
 		}
-	}
-	return 0.f;
-}
+
+		for (TObjectIterator<UWidgetComponent> It; It; ++It)
+		{
+			NumWidgetComponents += It->GetWorld() == World && !It->IsTemplate() ? 1 : 0;
+		}
+
+		for (TObjectIterator<UInteractionWidget> It; It; ++It)
+		{
+			NumWidgets += It->GetWorld() == World && !It->IsTemplate() ? 1 : 0;
+		}
+
+		const int32 ComponentSize = UInteractionComponent::StaticClass()->GetStructureSize();
+		const int32 WidgetComponentSize = UWidgetComponent::StaticClass()->GetStructureSize();
+
+		UE_LOG(LogTemp, Log, TEXT("%d interaction components (%d shared HUD), %d widget components, %d interaction widgets. An interaction component is %d bytes, a widget component %d bytes, so shared HUD mode saves at least %.1f KB of components"),
+			NumInteractables, NumSharedHUD, NumWidgetComponents, NumWidgets, ComponentSize, WidgetComponentSize, (float)NumSharedHUD * WidgetComponentSize / 1024.f);
+	}));
+#endif
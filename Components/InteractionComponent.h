@@ -3,7 +3,7 @@
 #pragma once
 
 #include "CoreMinimal.h"
-#include "Components/WidgetComponent.h"
+#include "Components/SceneComponent.h"
 #include "Delegates/Delegate.h"
 #include "InteractionComponent.generated.h"
 
@@ -16,6 +16,8 @@ struct FInteractionData
 	{
 		ViewedInteractionComponent = nullptr;
 		LastInteractionCheckTime = 0.f;
+		LastInteractionCheckLocation = FVector::ZeroVector;
+		LastInteractionCheckRotation = FRotator::ZeroRotator;
 		bInteractHeld = false;
 	}
 
@@ -27,23 +29,74 @@ struct FInteractionData
 	UPROPERTY()
 	float LastInteractionCheckTime;
 
+	// Where we were looking from, and in what direction, when we last checked
+	UPROPERTY()
+	FVector LastInteractionCheckLocation;
+
+	UPROPERTY()
+	FRotator LastInteractionCheckRotation;
+
 	// Whether the local player is holding the interact key
 	UPROPERTY()
 	bool bInteractHeld;
 
 };
 
+// How far through an interact one interactor is. Recorded once when the interact begins, so progress can be worked out from the time
+// rather than asking the timer manager every frame
+USTRUCT(BlueprintType)
+struct FInteractionProgress
+{
+	GENERATED_BODY()
+
+	FInteractionProgress()
+	{
+		Interactor = nullptr;
+		StartTime = 0.f;
+		Duration = 0.f;
+	}
+
+	UPROPERTY(BlueprintReadOnly, Category = "Interaction")
+	class ASurvivalCharacter* Interactor;
+
+	// World time the interact began
+	UPROPERTY(BlueprintReadOnly, Category = "Interaction")
+	float StartTime;
+
+	// How long the interact takes. Taken from InteractionTime when it began, so changing that doesn't affect interacts in progress
+	UPROPERTY(BlueprintReadOnly, Category = "Interaction")
+	float Duration;
+
+	float GetPercentage(const float CurrentTime) const
+	{
+		return Duration > 0.f ? FMath::Clamp((CurrentTime - StartTime) / Duration, 0.f, 1.f) : 1.f;
+	}
+};
+
+UENUM(BlueprintType)
+enum class EInteractionWidgetMode : uint8
+{
+	// Each interactable shows its own widget component, created the first time it is focused
+	IWM_PerInteractable UMETA(DisplayName = "Per Interactable"),
+	// The local player's controller owns one widget and points it at whatever they're focused on. Falls back to
+	// a per interactable widget if the player isn't using an ASurvivalPlayerController
+	IWM_SharedHUD UMETA(DisplayName = "Shared HUD")
+};
+
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnBeginInteract, class ASurvivalCharacter*, Character);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnEndInteract, class ASurvivalCharacter*, Character);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnBeginFocus, class ASurvivalCharacter*, Character);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnEndFocus, class ASurvivalCharacter*, Character);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnInteract, class ASurvivalCharacter*, Character);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnCancelInteract, class ASurvivalCharacter*, Character);
 
 UCLASS(ClassGroup = (Custom), meta = (BlueprintSpawnableComponent))
-class SURVIVALGAME_API UInteractionComponent : public UWidgetComponent
+class SURVIVALGAME_API UInteractionComponent : public USceneComponent
 {
 	GENERATED_BODY()
 
+	friend class UInteractionSubsystem;
+
 public:
 
 	UInteractionComponent();
@@ -68,6 +121,18 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Interaction")
 	bool bAllowMultipleInteractors;
 
+	// How the interaction prompt is shown. Nothing is created for either mode on a dedicated server
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Interaction|Widget")
+	EInteractionWidgetMode WidgetMode;
+
+	// The prompt to show when focused. In IWM_SharedHUD mode this is only used if the player controller doesn't set its own
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Interaction|Widget")
+	TSubclassOf<class UInteractionWidget> InteractionWidgetClass;
+
+	// The size of the prompt when it's drawn by our own widget component
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction|Widget")
+	FIntPoint WidgetDrawSize;
+
 	// Call this to change the name of the interactable. Will also refresh the interaction widget.
 	UFUNCTION(BlueprintCallable, Category = "Interaction")
 	void SetInteractableNameText(const FText& NewNameText);
@@ -97,16 +162,70 @@ public:
 	UPROPERTY(EditDefaultsOnly, BlueprintAssignable)
 	FOnInteract OnInteract;
 
+	//[local + server] Called when an interactor stops a timed interact before it finished. OnEndInteract is called straight after
+	UPROPERTY(EditDefaultsOnly, BlueprintAssignable)
+	FOnCancelInteract OnCancelInteract;
+
 protected:
 	// Called when the game starts
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	virtual void Activate(bool bReset = false) override;
 	virtual void Deactivate() override;
 
+	// Add/remove us to/from the interaction subsystem. Only active components that have begun play can be found
+	void UpdateRegistration(const bool bShouldRegister);
+
+	void OnTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+
+	// Where UInteractionSubsystem is keeping us, so it can move or remove us without searching
+	FIntVector GridCell;
+	int32 GridIndex;
+
+	// The widget component in IWM_PerInteractable mode, or when there's no shared widget. Only created on clients, the first time we're focused
+	UPROPERTY(Transient)
+	class UWidgetComponent* WidgetComponent;
+
+	// The local player controller showing us with its shared widget in IWM_SharedHUD mode, if any
+	TWeakObjectPtr<class ASurvivalPlayerController> SharedWidgetController;
+
+	class UWidgetComponent* GetOrCreateWidgetComponent();
+
+	// The owner's primitives that get custom depth turned on while we're focused. Found when we begin play rather than on every focus change
+	TArray<TWeakObjectPtr<class UPrimitiveComponent>> HighlightPrimitives;
+
+	// How many components the owner had when HighlightPrimitives was built. If this changes, components were added or removed and we look again
+	int32 HighlightOwnerComponentCount;
+
+	// Whether we want to be highlighted, whether we currently are, and whether UInteractionSubsystem has us queued to apply the difference
+	uint32 bWantsHighlight : 1;
+	uint32 bHighlighted : 1;
+	uint32 bHighlightQueued : 1;
+
+	void SetWantsHighlight(const bool bNewWantsHighlight);
+
+	// Called by UInteractionSubsystem once per frame for queued interactables. Returns true if the highlight changed
+	bool ApplyHighlight();
+
+	const TArray<TWeakObjectPtr<class UPrimitiveComponent>>& GetHighlightPrimitives();
+	void CacheHighlightPrimitives();
+
 	bool CanInteract(class ASurvivalCharacter* Character) const;
 
 	// On the server, this will hold all the interactors. On the local player, this will just hold the local player (provided they are an interactor)
 	UPROPERTY()
 	TArray<class ASurvivalCharacter*> Interactors;
 
+	// Progress of each interactor's unfinished interact. Removed when the interact completes or is cancelled
+	UPROPERTY()
+	TArray<FInteractionProgress> InteractionProgress;
+
+	const FInteractionProgress* FindInteractionProgress(const class ASurvivalCharacter* Character) const;
+
+	// The widget showing us to the given character, if it's the local player and we're the interactable it's showing
+	class UInteractionWidget* GetLocalInteractionWidget(const class ASurvivalCharacter* Character) const;
+
 
 public:
 
@@ -128,7 +247,19 @@ public:
 	//Return a value from 0-1 denoting how far through the interact we are.
 	//One server this is the first interactors percentage, on client this is the local interactors percentage
 	UFUNCTION(BlueprintPure, Category = "Interaction")
-	float GetInteractPercentage();
+	float GetInteractPercentage() const;
+
+	//Return a value from 0-1 denoting how far through the interact the given character is, or 0 if they aren't interacting with us
+	UFUNCTION(BlueprintPure, Category = "Interaction")
+	float GetInteractPercentageFor(const class ASurvivalCharacter* Character) const;
+
+	/** Find the primitives to highlight again next time we need them. Only needed if the owner swaps one component for another,
+	adding or removing components is noticed automatically */
+	UFUNCTION(BlueprintCallable, Category = "Interaction")
+	void InvalidateHighlightPrimitives();
+
+	/** Where the interaction prompt should be drawn */
+	FORCEINLINE FVector GetWidgetLocation() const { return GetComponentLocation(); };
 
 
 };
@@ -2,18 +2,47 @@
 
 
 #include "Components/InventoryComponent.h"
+#include "Items/ItemPool.h"
 #include "Net/UnrealNetwork.h"
 #include "Engine/ActorChannel.h"
+#include "Engine/NetConnection.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Engine/World.h"
+#include "TimerManager.h"
 
 
 #define  LOCTEXT_NAMESPACE "Inventory"
 
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+static TAutoConsoleVariable<int32> CVarValidateInventoryIndex(
+	TEXT("SurvivalGame.Inventory.ValidateIndex"),
+	0,
+	TEXT("If non-zero, inventories check their class lookup tables against a full scan of their items after every change."),
+	ECVF_Cheat);
+#endif
+
 // Sets default values for this component's properties
 UInventoryComponent::UInventoryComponent()
 {
 
 	SetIsReplicatedByDefault(true);
 
+	ReplicationMode = EInventoryReplicationMode::IRM_FastArray;
+	ReplicationPolicy = EInventoryReplicationPolicy::IRP_Everyone;
+	bReplicatePublicSummary = true;
+	bSharedItemsDirty = false;
+	bClientItemsDirty = false;
+	ClientViewerList = nullptr;
+	ItemEntries.OwnerInventory = this;
+	OwnerItemEntries.OwnerInventory = this;
+	SummaryEntries.OwnerInventory = this;
+	SummaryEntries.bFiltered = true;
+	DirtyItemLogStart = 0;
+	bInventoryUpdatePending = false;
+	bAggregatesChangePending = false;
+	bFlushScheduled = false;
+	BatchDepth = 0;
 }
 
 
@@ -24,9 +53,33 @@ FItemAddResult UInventoryComponent::TryAddItem(class UItem* Item)
 
 FItemAddResult UInventoryComponent::TryAddItemFromClass(TSubclassOf<class UItem> ItemClass, const int32 Quantity)
 {
-	UItem* Item = NewObject<UItem>(GetOwner(), ItemClass);
+	UItem* Item = UItemPool::CreateItem(GetOwner(), ItemClass);
 	Item->SetQuantity(Quantity);
-	return TryAddItem_Internal(Item);
+
+	// The inventory adds a copy of the item, so this one can go straight back to the pool
+	const FItemAddResult AddResult = TryAddItem_Internal(Item);
+	UItemPool::DestroyItem(Item);
+
+	return AddResult;
+}
+
+FItemAddResult UInventoryComponent::TryTransferItem(class UItem* Item)
+{
+	if (!Item)
+	{
+		return FItemAddResult::AddedNone(0, LOCTEXT("InventoryInvalidItemText", "Couldn't add the item to Inventory."));
+	}
+
+	UInventoryComponent* SourceInventory = Item->OwningInventory;
+	const FItemAddResult AddResult = TryAddItem_Internal(Item, true);
+
+	// If the item was merged into one of our stacks rather than moved over, take what we gave out of the inventory it came from.
+	if (SourceInventory && SourceInventory != this && Item->OwningInventory == SourceInventory && AddResult.ActualAmountGiven > 0)
+	{
+		SourceInventory->ConsumeItem(Item, AddResult.ActualAmountGiven);
+	}
+
+	return AddResult;
 }
 
 bool UInventoryComponent::RemoveItem(class UItem* Item)
@@ -35,11 +88,37 @@ bool UInventoryComponent::RemoveItem(class UItem* Item)
 	{
 		if (Item)
 		{
-			Items.RemoveSingle(Item);
+			const bool bWasInInventory = Items.RemoveSingle(Item) > 0;
+
+			if (bWasInInventory)
+			{
+				UnindexItem(Item);
+				ValidateItemIndex();
+				MarkInventoryDirty(true);
+
+				Item->RemovedFromInventory(this);
+				Item->OwningInventory = nullptr;
+			}
+
+			if (ReplicationMode == EInventoryReplicationMode::IRM_FastArray)
+			{
+				FInventoryEntryArray& Entries = GetItemEntries();
+				const int32 EntryIndex = Entries.Entries.IndexOfByPredicate([Item](const FInventoryEntry& Entry) { return Entry.Item == Item; });
+
+				if (EntryIndex != INDEX_NONE)
+				{
+					Entries.Entries.RemoveAt(EntryIndex);
+					Entries.MarkArrayDirty();
+				}
+			}
 
 			ReplicatedItemsKey++;
+			bSharedItemsDirty = true;
 
-			return true;
+			// The item isn't recycled here. Callers may still be holding it, ie to finish using it or to hand it to a pickup, and it has
+			// almost certainly been replicated, so UItemPool would skip it anyway. Callers that are done with it call UItemPool::DestroyItem()
+
+			return bWasInInventory;
 		}
 	}
 
@@ -48,24 +127,32 @@ bool UInventoryComponent::RemoveItem(class UItem* Item)
 
 bool UInventoryComponent::HasItem(TSubclassOf<UItem> ItemClass, const int32 Quantity /*= 1*/) const
 {
-	if (UItem* ItemToFind = FindItemByClass(ItemClass))
+	return FindItemByClass(ItemClass) && GetItemQuantity(ItemClass) >= Quantity;
+}
+
+int32 UInventoryComponent::GetItemQuantity(TSubclassOf<UItem> ItemClass) const
+{
+	if (const FIndexedStacks* IndexedStacks = FindIndexedStacks(ItemClass))
 	{
-		return ItemToFind->GetQuantity() >= Quantity;
+		return IndexedStacks->Quantity;
 	}
-	return false;
+	return 0;
+}
+
+int32 UInventoryComponent::GetItemQuantityById(const FItemId ItemId) const
+{
+	if (const FIndexedStacks* IndexedStacks = StacksById.Find(ItemId))
+	{
+		return IndexedStacks->Quantity;
+	}
+	return 0;
 }
 
 UItem* UInventoryComponent::FindItem(class UItem* Item) const
 {
 	if (Item)
 	{
-		for (auto& InvItem : Items)
-		{
-			if (InvItem && InvItem->GetClass() == Item->GetClass())
-			{
-				return InvItem;
-			}
-		}
+		return FindItemByClass(Item->GetClass());
 	}
 
 	return nullptr;
@@ -73,61 +160,124 @@ UItem* UInventoryComponent::FindItem(class UItem* Item) const
 
 UItem* UInventoryComponent::FindItemByClass(TSubclassOf<UItem> ItemClass) const
 {
-	for (auto& InvItem : Items)
-	{
-		if (InvItem && InvItem->GetClass() == ItemClass)
-		{
-			return InvItem;
-		}
-	}
+	const FIndexedStacks* IndexedStacks = FindIndexedStacks(ItemClass);
+	return IndexedStacks && IndexedStacks->Stacks.Num() > 0 ? IndexedStacks->Stacks[0] : nullptr;
+}
 
-	return nullptr;
+UItem* UInventoryComponent::FindItemById(const FItemId ItemId) const
+{
+	const FIndexedStacks* IndexedStacks = StacksById.Find(ItemId);
+	return IndexedStacks && IndexedStacks->Stacks.Num() > 0 ? IndexedStacks->Stacks[0] : nullptr;
 }
 
 TArray<UItem*> UInventoryComponent::FindItemsByClass(TSubclassOf<UItem> ItemClass) const
 {
-	TArray<UItem*> ItemsOfClass;
-
-	for (auto& InvItem : Items)
+	if (const TArray<UItem*>* ItemsOfClass = ItemsByParentClass.Find(ItemClass))
 	{
-		if (InvItem && InvItem->GetClass()->IsChildOf(ItemClass))
-		{
-			ItemsOfClass.Add(InvItem);
-		}
+		return *ItemsOfClass;
 	}
 
-	return ItemsOfClass;
+	return TArray<UItem*>();
 }
 
-float UInventoryComponent::GetCurrentWeight() const
+int32 UInventoryComponent::GetRarityQuantity(const EItemRarity Rarity) const
 {
-	float Weight = 0.f;
-
-	for (auto& Item : Items)
+	if (const int32* RarityQuantity = Aggregates.QuantityByRarity.Find(Rarity))
 	{
-		if (Item)
-		{
-			Weight += Item->GetStackWeight();
-		}
+		return *RarityQuantity;
 	}
-	return Weight;
+	return 0;
 }
 
 void UInventoryComponent::SetWeightCapacity(const float NewWeightCapacity)
 {
 	WeightCapacity = NewWeightCapacity;
-	OnInventoryUpdated.Broadcast();
+	MarkInventoryDirty(false);
 }
 
 void UInventoryComponent::SetCapacity(const int32 NewCapacity)
 {
 	Capacity = NewCapacity;
-	OnInventoryUpdated.Broadcast();
+	MarkInventoryDirty(false);
 }
 
 void UInventoryComponent::ClientRefreshInventory_Implementation()
 {
-	OnInventoryUpdated.Broadcast();
+	MarkInventoryDirty(false);
+}
+
+void UInventoryComponent::MarkInventoryDirty(const bool bAggregatesChanged)
+{
+	bInventoryUpdatePending = true;
+	bAggregatesChangePending |= bAggregatesChanged;
+
+	// The batch flushes when it ends
+	if (BatchDepth > 0 || bFlushScheduled)
+	{
+		return;
+	}
+
+	UWorld* World = GetWorld();
+
+	if (World && !World->bIsTearingDown)
+	{
+		bFlushScheduled = true;
+		World->GetTimerManager().SetTimerForNextTick(this, &UInventoryComponent::FlushInventoryNotifications);
+	}
+	else
+	{
+		FlushInventoryNotifications();
+	}
+}
+
+void UInventoryComponent::FlushInventoryNotifications()
+{
+	// Before clearing bFlushScheduled, so rebuilding doesn't schedule another flush
+	if (bClientItemsDirty)
+	{
+		RebuildClientItems();
+	}
+
+	bFlushScheduled = false;
+
+	// Clear the flags before broadcasting, listeners are allowed to change the inventory
+	const bool bBroadcastAggregates = bAggregatesChangePending;
+	const bool bBroadcastUpdate = bInventoryUpdatePending;
+
+	bAggregatesChangePending = false;
+	bInventoryUpdatePending = false;
+
+	if (bBroadcastAggregates)
+	{
+		OnAggregatesChanged.Broadcast();
+	}
+
+	if (bBroadcastUpdate)
+	{
+		OnInventoryUpdated.Broadcast();
+	}
+}
+
+FInventoryBatchScope::FInventoryBatchScope(class UInventoryComponent* InInventory)
+	: Inventory(InInventory)
+{
+	if (InInventory)
+	{
+		InInventory->BatchDepth++;
+	}
+}
+
+FInventoryBatchScope::~FInventoryBatchScope()
+{
+	if (UInventoryComponent* InventoryComponent = Inventory.Get())
+	{
+		check(InventoryComponent->BatchDepth > 0);
+
+		if (--InventoryComponent->BatchDepth == 0 && (InventoryComponent->bInventoryUpdatePending || InventoryComponent->bAggregatesChangePending))
+		{
+			InventoryComponent->FlushInventoryNotifications();
+		}
+	}
 }
 
 
@@ -136,188 +286,1158 @@ void UInventoryComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>&
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
-	DOREPLIFETIME(UInventoryComponent, Items)
+	DOREPLIFETIME(UInventoryComponent, ReplicationPolicy);
+
+	// The owner always gets the whole inventory, and so does everyone else under IRP_Everyone. Which of these are active depends on
+	// ReplicationMode and ReplicationPolicy. See PreReplication()
+	DOREPLIFETIME_CONDITION(UInventoryComponent, Items, COND_OwnerOnly);
+	DOREPLIFETIME(UInventoryComponent, ItemEntries);
+	DOREPLIFETIME_CONDITION(UInventoryComponent, OwnerItemEntries, COND_OwnerOnly);
+
+	// Everybody else gets what the ReplicationPolicy allows them
+	DOREPLIFETIME_CONDITION(UInventoryComponent, SummaryEntries, COND_SkipOwner);
+}
+
+void UInventoryComponent::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
+{
+	Super::PreReplication(ChangedPropertyTracker);
+
+	if (bSharedItemsDirty)
+	{
+		RebuildSharedItems();
+	}
+
+	const bool bFastArray = ReplicationMode == EInventoryReplicationMode::IRM_FastArray;
+	const bool bEveryone = ReplicationPolicy == EInventoryReplicationPolicy::IRP_Everyone;
+
+	DOREPLIFETIME_ACTIVE_OVERRIDE(UInventoryComponent, Items, !bFastArray);
+	DOREPLIFETIME_ACTIVE_OVERRIDE(UInventoryComponent, ItemEntries, bFastArray && bEveryone);
+	DOREPLIFETIME_ACTIVE_OVERRIDE(UInventoryComponent, OwnerItemEntries, bFastArray && !bEveryone);
+	DOREPLIFETIME_ACTIVE_OVERRIDE(UInventoryComponent, SummaryEntries, bEveryone ? !bFastArray : bReplicatePublicSummary);
+}
+
+FInventoryEntryArray& UInventoryComponent::GetItemEntries()
+{
+	return ReplicationPolicy == EInventoryReplicationPolicy::IRP_Everyone ? ItemEntries : OwnerItemEntries;
 }
 
 bool UInventoryComponent::ReplicateSubobjects(class UActorChannel* Channel, class FOutBunch* Bunch, FReplicationFlags* RepFlags)
 {
 	bool bWroteSomething = Super::ReplicateSubobjects(Channel, Bunch, RepFlags);
 
-
-	// Check if the array of items needs to replicate
-	if (Channel->KeyNeedsToReplicate(0, ReplicatedItemsKey))
+	// Viewer lists only ever go to the viewer they're for. The owner already has the whole inventory
+	if (!RepFlags->bNetOwner)
 	{
-		for (auto& Item : Items)
+		if (UInventoryViewerList* ViewerList = FindViewerList(Channel->Connection))
 		{
-			if (Channel->KeyNeedsToReplicate(Item->GetUniqueID(), Item->RepKey))
-			{
-				bWroteSomething |= Channel->ReplicateSubobject(Item, *Bunch, *RepFlags);
-			}
+			bWroteSomething |= Channel->ReplicateSubobject(ViewerList, *Bunch, *RepFlags);
 		}
 	}
 
+	const EItemAccess Access = GetItemAccess(Channel, RepFlags);
+
+	if (Access == EItemAccess::None)
+	{
+		return bWroteSomething;
+	}
+
+	if (ReplicationMode == EInventoryReplicationMode::IRM_FastArray)
+	{
+		bWroteSomething |= ReplicateDirtyItems(Channel, Bunch, RepFlags, Access);
+	}
+	// Check if the array of items needs to replicate
+	else if (Channel->KeyNeedsToReplicate(0, ReplicatedItemsKey))
+	{
+		bWroteSomething |= ReplicateAllItems(Channel, Bunch, RepFlags, Access);
+	}
+
 	return bWroteSomething;
 }
 
-UItem* UInventoryComponent::AddItem(class UItem* Item)
+UInventoryComponent::EItemAccess UInventoryComponent::GetItemAccess(class UActorChannel* Channel, const FReplicationFlags* RepFlags) const
 {
+	if (ReplicationPolicy == EInventoryReplicationPolicy::IRP_Everyone || RepFlags->bNetOwner || RepFlags->bReplay)
+	{
+		return EItemAccess::Full;
+	}
 
-	if (GetOwner() && GetOwner()->HasAuthority())
+	if (ReplicationPolicy == EInventoryReplicationPolicy::IRP_ViewersOnly)
 	{
-		UItem* NewItem = NewObject<UItem>(GetOwner(), Item->GetClass());
-		NewItem->SetQuantity(Item->GetQuantity());
-		NewItem->OwningInventory = this;
-		NewItem->AddedToInventory(this);
-		Items.Add(NewItem);
-		NewItem->MarkDirtyForReplication();
+		const UInventoryViewerList* ViewerList = FindViewerList(Channel->Connection);
 
-		return NewItem;
+		if (ViewerList && ViewerList->bViewing)
+		{
+			return EItemAccess::Full;
+		}
 	}
 
-	return nullptr;
+	return bReplicatePublicSummary ? EItemAccess::Summary : EItemAccess::None;
 }
 
-void UInventoryComponent::OnRep_Items()
+bool UInventoryComponent::CanReplicateItemTo(const class UItem* Item, const EItemAccess Access) const
 {
-	OnInventoryUpdated.Broadcast();
+	return Access == EItemAccess::Full || (Access == EItemAccess::Summary && Item->ShouldReplicateInSummary());
 }
 
-FItemAddResult UInventoryComponent::TryAddItem_Internal(class UItem* Item)
+void UInventoryComponent::SetReplicationPolicy(const EInventoryReplicationPolicy NewPolicy, const bool bNewReplicatePublicSummary)
 {
-	if (GetOwner() && GetOwner()->HasAuthority())
+	if (ReplicationPolicy != NewPolicy || bReplicatePublicSummary != bNewReplicatePublicSummary)
 	{
-		const int32 AddAmount = Item->GetQuantity();
+		// Going to or from IRP_Everyone changes which array mirrors Items. Clients rebuild Items when they get the new policy
+		FInventoryEntryArray& OldEntries = GetItemEntries();
+		ReplicationPolicy = NewPolicy;
+		FInventoryEntryArray& NewEntries = GetItemEntries();
 
-		if (Items.Num() + 1 > GetCapacity())
+		if (&OldEntries != &NewEntries)
 		{
-			return FItemAddResult::AddedNone(AddAmount, LOCTEXT("InventoryCapacityFullText", "Couldn't add the item to Inventory. Inventory is full"));
+			// Added fresh rather than moved, so they get IDs from the array they're in now
+			for (const FInventoryEntry& Entry : OldEntries.Entries)
+			{
+				NewEntries.MarkItemDirty(NewEntries.Entries.Add_GetRef(FInventoryEntry(Entry.Item)));
+			}
+
+			OldEntries.Entries.Reset();
+			OldEntries.MarkArrayDirty();
 		}
 
-		// Items with a weight of zero don't require weight check
-		if (!FMath::IsNearlyZero(Item->Weight))
+		bReplicatePublicSummary = bNewReplicatePublicSummary;
+
+		bSharedItemsDirty = true;
+		ResetItemReplication();
+	}
+}
+
+void UInventoryComponent::AddViewer(class APlayerController* Viewer)
+{
+	if (!Viewer || !GetOwner() || !GetOwner()->HasAuthority())
+	{
+		return;
+	}
+
+	UInventoryViewerList* const* FoundList = ViewerLists.FindByPredicate([Viewer](const UInventoryViewerList* List) { return List->Viewer.Get() == Viewer; });
+	UInventoryViewerList* ViewerList = FoundList ? *FoundList : nullptr;
+
+	if (!ViewerList)
+	{
+		ViewerList = NewObject<UInventoryViewerList>(GetOwner());
+		ViewerList->Inventory = this;
+		ViewerList->Viewer = Viewer;
+		ViewerLists.Add(ViewerList);
+	}
+
+	if (!ViewerList->bViewing)
+	{
+		ViewerList->bViewing = true;
+		bSharedItemsDirty = true;
+		ResetItemReplication();
+	}
+}
+
+void UInventoryComponent::RemoveViewer(class APlayerController* Viewer)
+{
+	for (UInventoryViewerList* ViewerList : ViewerLists)
+	{
+		if (ViewerList->Viewer.Get() == Viewer && ViewerList->bViewing)
 		{
-			if (GetCurrentWeight() + Item->Weight > GetWeightCapacity())
-			{
-				return FItemAddResult::AddedNone(AddAmount, LOCTEXT("InventoryTooMuchWeightText", "Couldn't add the item to Inventory. Carrying too much weight"));
-			}
+			// Keep the list so the empty version still reaches the viewer. It's reused if they look again
+			ViewerList->bViewing = false;
+			ViewerList->Entries.SyncEntries(TArray<UItem*>());
 		}
+	}
+}
 
-		// If the item is stackable, check if we already have it and add it to their stack
-		if (Item->bStackable)
+class UInventoryViewerList* UInventoryComponent::FindViewerList(const class UNetConnection* Connection) const
+{
+	for (UInventoryViewerList* ViewerList : ViewerLists)
+	{
+		if (ViewerList->Viewer.IsValid() && ViewerList->Viewer->GetNetConnection() == Connection)
 		{
-			// Somehow the items quantity went over the max stack size. This shouldn't ever happen
-			ensure(Item->GetQuantity() <= Item->MaxStackSize);
+			return ViewerList;
+		}
+	}
 
-			if (UItem* ExistingItem = FindItem(Item))
-			{
-				if (ExistingItem->GetQuantity() < ExistingItem->MaxStackSize)
-				{
-					// Find out how much of the item to add
-					const int32 CapacityMaxAddAmount = ExistingItem->MaxStackSize - ExistingItem->GetQuantity();
-					int32 ActualAddAmount = FMath::Min(AddAmount, CapacityMaxAddAmount);
+	return nullptr;
+}
 
-					FText ErrorText = LOCTEXT("InventoryErrorText", "Couldn't add all of the items to your inventory.");
+void UInventoryComponent::ResetItemReplication()
+{
+	// Channels that couldn't see some of the items before need a full pass to pick them up now
+	ChannelItemGenerations.Reset();
+	++ReplicatedItemsKey;
+}
 
-					// Adjust based on how much weight we can carry
-					if (!FMath::IsNearlyZero(Item->Weight))
-					{
-						// Find the maximum amount of the item we could take due to weight
-						const int32 WeightMaxAddAmount = FMath::FloorToInt((WeightCapacity - GetCurrentWeight()) / Item->Weight);
-						ActualAddAmount = FMath::Min(ActualAddAmount, WeightMaxAddAmount);
-
-						if (ActualAddAmount < AddAmount)
-						{
-							ErrorText = FText::Format(LOCTEXT("InventoryTooMuchWeightText", "Couldn't add entire stack of {ItemName} to Inventory."), Item->ItemDisplayName);
-						}
-					}
-					else if (ActualAddAmount < AddAmount)
-					{
-						// If the item weighs none an we can take it, then there was a capacity issue
-						ErrorText = FText::Format(LOCTEXT("InventoryCapacityFullText", "Couldn't add the entire stack of {ItemName} to Inventory. Inventory is Full."), Item->ItemDisplayName);
-					}
-					if (ActualAddAmount <= 0)
-					{
-						return FItemAddResult::AddedNone(AddAmount, LOCTEXT("InventoryErrorText", "Couldn't add item to inventory."));
-					}
+void UInventoryComponent::RebuildSharedItems()
+{
+	bSharedItemsDirty = false;
 
-					ExistingItem->SetQuantity(ExistingItem->GetQuantity() + ActualAddAmount);
+	// Viewers only see the whole inventory under IRP_ViewersOnly. Lists of viewers that have gone away can't be sent anywhere
+	ViewerLists.RemoveAllSwap([](const UInventoryViewerList* List) { return !List->Viewer.IsValid(); });
 
-					// If somehow we get more of the item than the max stack size then something is wrong with our math
-					ensure(ExistingItem->GetQuantity() <= ExistingItem->MaxStackSize);
+	for (UInventoryViewerList* ViewerList : ViewerLists)
+	{
+		ViewerList->bViewing &= ReplicationPolicy == EInventoryReplicationPolicy::IRP_ViewersOnly;
+		ViewerList->Entries.SyncEntries(ViewerList->bViewing ? Items : TArray<UItem*>());
+	}
 
-					if (ActualAddAmount < AddAmount)
-					{
-						return FItemAddResult::AddedSome(AddAmount, ActualAddAmount, ErrorText);
-					}
-					else
-					{
-						return FItemAddResult::AddedAll(AddAmount);
-					}
-				}
-				else
-				{
-					return FItemAddResult::AddedNone(AddAmount, FText::Format(LOCTEXT("InventoryFullStackText", "Couldn't add {ItemName}. You already have a full stack of this item."), Item->ItemDisplayName));
-				}
-			}
-			else
-			{
-				/** Since we don't have any of this item, we'll add the full stack */
-				AddItem(Item);
+	const bool bEveryone = ReplicationPolicy == EInventoryReplicationPolicy::IRP_Everyone;
 
-				return FItemAddResult::AddedAll(AddAmount);
-			}
-		}
-		else // item is non-stackable
-		{
-			// Non-stackable items should always have a quantity of 1
-			ensure(Item->GetQuantity() == 1);
+	// Under IRP_Everyone every client gets ItemEntries, so the summary is only needed for IRM_RepKey's non-owners
+	if (bEveryone && ReplicationMode == EInventoryReplicationMode::IRM_RepKey)
+	{
+		SummaryEntries.SyncEntries(Items);
+		return;
+	}
 
-			AddItem(Item);
+	TArray<UItem*> SummaryItems;
 
-			return FItemAddResult::AddedAll(AddAmount);
+	if (!bEveryone && bReplicatePublicSummary)
+	{
+		for (auto& Item : Items)
+		{
+			if (Item && Item->ShouldReplicateInSummary())
+			{
+				SummaryItems.Add(Item);
+			}
 		}
 	}
 
-	//AddItem should never be called on a client.
-	check(false);
-	return FItemAddResult::AddedNone(-1, LOCTEXT("ErrorMessage", ""));
+	SummaryEntries.SyncEntries(SummaryItems);
+}
+
+void UInventoryComponent::OnRep_ReplicationPolicy()
+{
+	// We may have moved to entries we already had from before, which won't send them again. IRM_RepKey owners get Items itself
+	if (ReplicationMode == EInventoryReplicationMode::IRM_FastArray)
+	{
+		RebuildClientItems();
+	}
 }
 
+void UInventoryComponent::OnFilteredEntriesChanged()
+{
+	bClientItemsDirty = true;
+	MarkInventoryDirty(true);
+}
 
-int32 UInventoryComponent::ConsumeItem(class UItem* Item, const int32 Quantity)
+void UInventoryComponent::RebuildClientItems()
 {
-	if (GetOwner() && GetOwner()->HasAuthority() && Item)
+	bClientItemsDirty = false;
+
+	Items.Reset();
+
+	auto AddEntries = [this](const FInventoryEntryArray& Source)
 	{
-		const int32 RemoveQuantity = FMath::Min(Quantity, Item->GetQuantity());
+		for (const FInventoryEntry& Entry : Source.Entries)
+		{
+			// Items whose subobjects haven't arrived yet don't resolve
+			if (Entry.Item)
+			{
+				Items.Add(Entry.Item);
+			}
+		}
+	};
 
-		// We shouldn't have a negative amount of the item after the drop
-		ensure(!(Item->GetQuantity() - RemoveQuantity < 0));
+	if (ReplicationMode == EInventoryReplicationMode::IRM_FastArray && ReplicationPolicy == EInventoryReplicationPolicy::IRP_Everyone)
+	{
+		AddEntries(ItemEntries);
+	}
+	else
+	{
+		// Only the owner gets OwnerItemEntries, and it never gets the summary or a viewer list, so at most one of these has anything in it
+		AddEntries(OwnerItemEntries);
+		AddEntries(ClientViewerList && ClientViewerList->bViewing ? ClientViewerList->Entries : SummaryEntries);
+	}
 
-		// We now have zero of this item, remove it from the inventory
-		Item->SetQuantity(Item->GetQuantity() - RemoveQuantity);
+	RebuildItemIndex();
+}
 
-		if (Item->GetQuantity() <= 0)
+void FInventoryEntryArray::SyncEntries(const TArray<class UItem*>& NewItems)
+{
+	const TSet<UItem*> NewItemSet(NewItems);
+	TSet<UItem*> ExistingItems;
+	bool bRemovedAny = false;
+
+	for (int32 i = Entries.Num() - 1; i >= 0; --i)
+	{
+		if (NewItemSet.Contains(Entries[i].Item))
 		{
-			RemoveItem(Item);
+			ExistingItems.Add(Entries[i].Item);
 		}
 		else
 		{
-			ClientRefreshInventory();
+			Entries.RemoveAtSwap(i, 1, false);
+			bRemovedAny = true;
 		}
+	}
 
-		return RemoveQuantity;
+	if (bRemovedAny)
+	{
+		MarkArrayDirty();
+	}
+
+	for (UItem* Item : NewItems)
+	{
+		if (!ExistingItems.Contains(Item))
+		{
+			MarkItemDirty(Entries.Add_GetRef(FInventoryEntry(Item)));
+		}
 	}
-	
-	return 0;
 }
 
-int32 UInventoryComponent::ConsumeItem(class UItem* Item)
+UInventoryViewerList::UInventoryViewerList()
 {
-	if (Item)
+	Inventory = nullptr;
+	bViewing = false;
+	Entries.bFiltered = true;
+}
+
+void UInventoryViewerList::GetLifetimeReplicatedProps(TArray<class FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(UInventoryViewerList, Inventory);
+	DOREPLIFETIME(UInventoryViewerList, bViewing);
+	DOREPLIFETIME(UInventoryViewerList, Entries);
+}
+
+void UInventoryViewerList::OnRep_ViewerList()
+{
+	if (Inventory)
+	{
+		// The entries can arrive before Inventory does, in which case they had nobody to tell. Rebuilding picks them up
+		Entries.OwnerInventory = Inventory;
+		Inventory->ClientViewerList = this;
+		Inventory->OnFilteredEntriesChanged();
+	}
+}
+
+bool UInventoryComponent::ReplicateAllItems(class UActorChannel* Channel, class FOutBunch* Bunch, FReplicationFlags* RepFlags, const EItemAccess Access)
+{
+	bool bWroteSomething = false;
+
+	for (auto& Item : Items)
+	{
+		if (Item && CanReplicateItemTo(Item, Access) && Channel->KeyNeedsToReplicate(Item->GetUniqueID(), Item->RepKey))
+		{
+			bWroteSomething |= Channel->ReplicateSubobject(Item, *Bunch, *RepFlags);
+		}
+	}
+
+	return bWroteSomething;
+}
+
+bool UInventoryComponent::ReplicateDirtyItems(class UActorChannel* Channel, class FOutBunch* Bunch, FReplicationFlags* RepFlags, const EItemAccess Access)
+{
+	bool bWroteSomething = false;
+
+	const int32 CurrentGeneration = DirtyItemLogStart + DirtyItemLog.Num();
+	int32* FoundGeneration = ChannelItemGenerations.Find(Channel);
+	int32& ChannelGeneration = FoundGeneration ? *FoundGeneration : ChannelItemGenerations.Add(Channel, INDEX_NONE);
+
+	if (ChannelGeneration == CurrentGeneration)
+	{
+		return false;
+	}
+
+	// New channels, and channels so far behind the log has been trimmed past them, need to check everything once
+	if (ChannelGeneration < DirtyItemLogStart)
+	{
+		bWroteSomething = ReplicateAllItems(Channel, Bunch, RepFlags, Access);
+	}
+	else
+	{
+		for (int32 i = ChannelGeneration - DirtyItemLogStart; i < DirtyItemLog.Num(); ++i)
+		{
+			UItem* Item = DirtyItemLog[i].Get();
+
+			// The item may have been dirtied more than once, or been removed since it was logged
+			if (Item && Item->OwningInventory == this && CanReplicateItemTo(Item, Access) && Channel->KeyNeedsToReplicate(Item->GetUniqueID(), Item->RepKey))
+			{
+				bWroteSomething |= Channel->ReplicateSubobject(Item, *Bunch, *RepFlags);
+			}
+		}
+	}
+
+	ChannelGeneration = CurrentGeneration;
+
+	return bWroteSomething;
+}
+
+void UInventoryComponent::MarkItemDirty(class UItem* Item)
+{
+	// Mark the array for replication
+	++ReplicatedItemsKey;
+
+	// The item may have moved in or out of the public summary, ie by being equipped
+	bSharedItemsDirty = true;
+
+	if (ReplicationMode != EInventoryReplicationMode::IRM_FastArray || !Item || !GetOwner() || !GetOwner()->HasAuthority())
+	{
+		return;
+	}
+
+	FInventoryEntryArray& Entries = GetItemEntries();
+
+	if (FInventoryEntry* Entry = Entries.Entries.FindByPredicate([Item](const FInventoryEntry& InEntry) { return InEntry.Item == Item; }))
+	{
+		Entries.MarkItemDirty(*Entry);
+	}
+
+	DirtyItemLog.Add(Item);
+
+	// Keep the log from growing forever. Channels that haven't caught up will just do a full check next time.
+	const int32 MaxLogSize = FMath::Max(Items.Num(), 16) * 2;
+
+	if (DirtyItemLog.Num() > MaxLogSize)
+	{
+		const int32 NumToTrim = DirtyItemLog.Num() / 2;
+
+		DirtyItemLog.RemoveAt(0, NumToTrim, false);
+		DirtyItemLogStart += NumToTrim;
+
+		// Also a good time to forget about channels that have closed
+		for (auto It = ChannelItemGenerations.CreateIterator(); It; ++It)
+		{
+			if (!It.Key().IsValid())
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
+}
+
+void UInventoryComponent::OnEntryAdded(class UItem* Item)
+{
+	// The item pointer can arrive before the item itself does. When it resolves we'll get OnEntryChanged instead.
+	if (Item && !IsItemIndexed(Item))
+	{
+		Item->OwningInventory = this;
+		Items.Add(Item);
+		IndexItem(Item);
+		ValidateItemIndex();
+
+		MarkInventoryDirty(true);
+	}
+}
+
+void UInventoryComponent::OnEntryRemoved(class UItem* Item)
+{
+	if (Item && Items.RemoveSingle(Item) > 0)
+	{
+		UnindexItem(Item);
+		ValidateItemIndex();
+
+		MarkInventoryDirty(true);
+	}
+}
+
+void UInventoryComponent::OnEntryChanged(class UItem* Item)
+{
+	if (Item && !IsItemIndexed(Item))
+	{
+		OnEntryAdded(Item);
+	}
+	else
+	{
+		MarkInventoryDirty(false);
+	}
+}
+
+void FInventoryEntry::PreReplicatedRemove(const struct FInventoryEntryArray& InArraySerializer)
+{
+	if (InArraySerializer.OwnerInventory && InArraySerializer.bFiltered)
+	{
+		InArraySerializer.OwnerInventory->OnFilteredEntriesChanged();
+	}
+	else if (InArraySerializer.OwnerInventory)
+	{
+		InArraySerializer.OwnerInventory->OnEntryRemoved(Item);
+	}
+}
+
+void FInventoryEntry::PostReplicatedAdd(const struct FInventoryEntryArray& InArraySerializer)
+{
+	if (InArraySerializer.OwnerInventory && InArraySerializer.bFiltered)
+	{
+		InArraySerializer.OwnerInventory->OnFilteredEntriesChanged();
+	}
+	else if (InArraySerializer.OwnerInventory)
+	{
+		InArraySerializer.OwnerInventory->OnEntryAdded(Item);
+	}
+}
+
+void FInventoryEntry::PostReplicatedChange(const struct FInventoryEntryArray& InArraySerializer)
+{
+	if (InArraySerializer.OwnerInventory && InArraySerializer.bFiltered)
+	{
+		InArraySerializer.OwnerInventory->OnFilteredEntriesChanged();
+	}
+	else if (InArraySerializer.OwnerInventory)
+	{
+		InArraySerializer.OwnerInventory->OnEntryChanged(Item);
+	}
+}
+
+UItem* UInventoryComponent::AddItem(class UItem* Item)
+{
+
+	if (GetOwner() && GetOwner()->HasAuthority())
+	{
+		UItem* NewItem = UItemPool::CreateItem(GetOwner(), Item->GetClass());
+		NewItem->SetQuantity(Item->GetQuantity());
+		InsertItem(NewItem);
+
+		return NewItem;
+	}
+
+	return nullptr;
+}
+
+UItem* UInventoryComponent::AdoptItem(class UItem* Item)
+{
+	if (GetOwner() && GetOwner()->HasAuthority())
+	{
+		// Take the item out of its old inventory, which leaves it for us to own
+		if (Item->OwningInventory)
+		{
+			Item->OwningInventory->RemoveItem(Item);
+		}
+
+		UItem* AdoptedItem = Item->MoveToOuter(GetOwner());
+		InsertItem(AdoptedItem);
+
+		return AdoptedItem;
+	}
+
+	return nullptr;
+}
+
+void UInventoryComponent::InsertItem(class UItem* Item)
+{
+	Item->OwningInventory = this;
+	Items.Add(Item);
+
+	if (ReplicationMode == EInventoryReplicationMode::IRM_FastArray)
+	{
+		FInventoryEntryArray& Entries = GetItemEntries();
+		Entries.MarkItemDirty(Entries.Entries.Add_GetRef(FInventoryEntry(Item)));
+	}
+
+	IndexItem(Item);
+	ValidateItemIndex();
+	MarkInventoryDirty(true);
+
+	// Bumps the item's RepKey and our ReplicatedItemsKey, so the item replicates once to this owner's channels
+	Item->AddedToInventory(this);
+}
+
+void UInventoryComponent::OnRep_Items()
+{
+	RebuildItemIndex();
+	MarkInventoryDirty(false);
+}
+
+bool UInventoryComponent::IsItemIndexed(class UItem* Item) const
+{
+	const FIndexedStacks* IndexedStacks = Item ? FindIndexedStacks(Item->GetClass()) : nullptr;
+	return IndexedStacks && IndexedStacks->Stacks.Contains(Item);
+}
+
+const UInventoryComponent::FIndexedStacks* UInventoryComponent::FindIndexedStacks(const UClass* ItemClass) const
+{
+	// Items and classes are keyed by the same ID, cached on the class default object, so this finds what FindOrAddIndexedStacks() filed
+	const FItemId ItemId = UItem::GetItemIdOfClass(ItemClass, this);
+	return ItemId.IsValid() ? StacksById.Find(ItemId) : StacksByUncataloguedClass.Find(ItemClass);
+}
+
+UInventoryComponent::FIndexedStacks* UInventoryComponent::FindIndexedStacks(const class UItem* Item)
+{
+	const FItemId ItemId = UItem::GetItemIdOfClass(Item->GetClass(), this);
+	return ItemId.IsValid() ? StacksById.Find(ItemId) : StacksByUncataloguedClass.Find(Item->GetClass());
+}
+
+UInventoryComponent::FIndexedStacks& UInventoryComponent::FindOrAddIndexedStacks(const class UItem* Item)
+{
+	const FItemId ItemId = UItem::GetItemIdOfClass(Item->GetClass(), this);
+	return ItemId.IsValid() ? StacksById.FindOrAdd(ItemId) : StacksByUncataloguedClass.FindOrAdd(Item->GetClass());
+}
+
+void UInventoryComponent::RemoveIndexedStacks(const class UItem* Item)
+{
+	const FItemId ItemId = UItem::GetItemIdOfClass(Item->GetClass(), this);
+
+	if (ItemId.IsValid())
+	{
+		StacksById.Remove(ItemId);
+	}
+	else
+	{
+		StacksByUncataloguedClass.Remove(Item->GetClass());
+	}
+}
+
+void UInventoryComponent::IndexItem(class UItem* Item)
+{
+	if (!Item)
+	{
+		return;
+	}
+
+	UClass* ItemClass = Item->GetClass();
+
+	FIndexedStacks& IndexedStacks = FindOrAddIndexedStacks(Item);
+	IndexedStacks.Stacks.Add(Item);
+	IndexedStacks.Quantity += Item->GetQuantity();
+
+	Aggregates.TotalWeight += Item->GetStackWeight();
+	Aggregates.NumSlots++;
+	Aggregates.QuantityByRarity.FindOrAdd(Item->GetRarity()) += Item->GetQuantity();
+
+	// Add the item to the bucket of every class it derives from, so FindItemsByClass(UEquippableItem::StaticClass()) etc is a single lookup
+	for (UClass* ParentClass = ItemClass; ParentClass; ParentClass = ParentClass->GetSuperClass())
+	{
+		ItemsByParentClass.FindOrAdd(ParentClass).Add(Item);
+
+		if (ParentClass == UItem::StaticClass())
+		{
+			break;
+		}
+	}
+}
+
+void UInventoryComponent::UnindexItem(class UItem* Item)
+{
+	if (!Item)
+	{
+		return;
+	}
+
+	UClass* ItemClass = Item->GetClass();
+
+	FIndexedStacks* IndexedStacks = FindIndexedStacks(Item);
+
+	// RemoveSingle keeps the order, so the first stack stays the oldest one just like a scan of Items would return
+	if (IndexedStacks && IndexedStacks->Stacks.RemoveSingle(Item) > 0)
+	{
+		if (IndexedStacks->Stacks.Num() == 0)
+		{
+			RemoveIndexedStacks(Item);
+		}
+		else
+		{
+			IndexedStacks->Quantity -= Item->GetQuantity();
+		}
+
+		Aggregates.NumSlots--;
+		Aggregates.QuantityByRarity.FindOrAdd(Item->GetRarity()) -= Item->GetQuantity();
+
+		// Don't let float error build up over a long session, an empty inventory weighs exactly nothing
+		Aggregates.TotalWeight = Aggregates.NumSlots > 0 ? FMath::Max(0.f, Aggregates.TotalWeight - Item->GetStackWeight()) : 0.f;
+	}
+
+	for (UClass* ParentClass = ItemClass; ParentClass; ParentClass = ParentClass->GetSuperClass())
+	{
+		if (TArray<UItem*>* ItemsOfClass = ItemsByParentClass.Find(ParentClass))
+		{
+			ItemsOfClass->RemoveSingle(Item);
+
+			if (ItemsOfClass->Num() == 0)
+			{
+				ItemsByParentClass.Remove(ParentClass);
+			}
+		}
+
+		if (ParentClass == UItem::StaticClass())
+		{
+			break;
+		}
+	}
+}
+
+void UInventoryComponent::RebuildItemIndex()
+{
+	StacksById.Reset();
+	StacksByUncataloguedClass.Reset();
+	ItemsByParentClass.Reset();
+	Aggregates = FInventoryAggregates();
+
+	for (auto& Item : Items)
+	{
+		if (Item)
+		{
+			// Clients don't get OwningInventory replicated, but need it so quantity changes reach the lookup tables
+			Item->OwningInventory = this;
+			IndexItem(Item);
+		}
+	}
+
+	ValidateItemIndex();
+	MarkInventoryDirty(true);
+}
+
+void UInventoryComponent::OnItemQuantityChanged(class UItem* Item, const int32 OldQuantity)
+{
+	if (Item)
+	{
+		// On clients an item can replicate its quantity before or after it has been added to/removed from Items
+		if (IsItemIndexed(Item))
+		{
+			const int32 QuantityDelta = Item->GetQuantity() - OldQuantity;
+
+			FindOrAddIndexedStacks(Item).Quantity += QuantityDelta;
+			Aggregates.QuantityByRarity.FindOrAdd(Item->GetRarity()) += QuantityDelta;
+			Aggregates.TotalWeight = FMath::Max(0.f, Aggregates.TotalWeight + QuantityDelta * Item->GetWeight());
+
+			ValidateItemIndex();
+
+			// This is also how the owning client finds out a stack it already has changed size
+			MarkInventoryDirty(true);
+		}
+	}
+}
+
+void UInventoryComponent::ValidateItemIndex() const
+{
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+	if (CVarValidateInventoryIndex.GetValueOnGameThread() == 0)
+	{
+		return;
+	}
+
+	TMap<UClass*, int32> ExpectedStacks;
+	TMap<UClass*, int32> ExpectedQuantities;
+	FInventoryAggregates ExpectedAggregates;
+
+	for (auto& Item : Items)
+	{
+		if (Item)
+		{
+			ExpectedStacks.FindOrAdd(Item->GetClass())++;
+			ExpectedQuantities.FindOrAdd(Item->GetClass()) += Item->GetQuantity();
+
+			ExpectedAggregates.TotalWeight += Item->GetStackWeight();
+			ExpectedAggregates.NumSlots++;
+			ExpectedAggregates.QuantityByRarity.FindOrAdd(Item->GetRarity()) += Item->GetQuantity();
+
+			const TArray<UItem*>* ItemsOfClass = ItemsByParentClass.Find(UItem::StaticClass());
+			ensureMsgf(ItemsOfClass && ItemsOfClass->Contains(Item), TEXT("%s is missing from the class buckets of %s"), *Item->GetName(), *GetName());
+		}
+	}
+
+	ensureMsgf(ExpectedAggregates.NumSlots == Aggregates.NumSlots, TEXT("%s counts %d used slots but holds %d items"), *GetName(), Aggregates.NumSlots, ExpectedAggregates.NumSlots);
+	ensureMsgf(FMath::IsNearlyEqual(ExpectedAggregates.TotalWeight, Aggregates.TotalWeight, 0.01f), TEXT("%s has a running weight of %f but its items weigh %f"), *GetName(), Aggregates.TotalWeight, ExpectedAggregates.TotalWeight);
+
+	for (auto& Expected : ExpectedAggregates.QuantityByRarity)
+	{
+		ensureMsgf(GetRarityQuantity(Expected.Key) == Expected.Value, TEXT("%s has the wrong quantity of rarity %d"), *GetName(), (int32)Expected.Key);
+	}
+
+	const int32 NumIndexedClasses = StacksById.Num() + StacksByUncataloguedClass.Num();
+	ensureMsgf(ExpectedStacks.Num() == NumIndexedClasses, TEXT("%s indexes %d item classes but holds %d"), *GetName(), NumIndexedClasses, ExpectedStacks.Num());
+
+	for (auto& Expected : ExpectedStacks)
+	{
+		const FIndexedStacks* IndexedStacks = FindIndexedStacks(Expected.Key);
+
+		ensureMsgf(IndexedStacks && IndexedStacks->Stacks.Num() == Expected.Value, TEXT("%s has the wrong number of %s stacks indexed"), *GetName(), *GetNameSafe(Expected.Key));
+		ensureMsgf(IndexedStacks && IndexedStacks->Quantity == ExpectedQuantities[Expected.Key], TEXT("%s has the wrong quantity of %s indexed"), *GetName(), *GetNameSafe(Expected.Key));
+	}
+#endif
+}
+
+FItemAddResult UInventoryComponent::PlanItemAdd(const class UItem* Item, const int32 AddAmount, const int32 SlotsUsed, const float CurrentWeight, const int32 ExistingStackQuantity) const
+{
+	if (SlotsUsed + 1 > GetCapacity())
+	{
+		return FItemAddResult::AddedNone(AddAmount, LOCTEXT("InventoryCapacityFullText", "Couldn't add the item to Inventory. Inventory is full"));
+	}
+
+	// Items with a weight of zero don't require weight check
+	if (!FMath::IsNearlyZero(Item->GetWeight()))
+	{
+		if (CurrentWeight + Item->GetWeight() > GetWeightCapacity())
+		{
+			return FItemAddResult::AddedNone(AddAmount, LOCTEXT("InventoryTooMuchWeightText", "Couldn't add the item to Inventory. Carrying too much weight"));
+		}
+	}
+
+	// If the item is stackable, check if we already have it and add it to their stack
+	if (Item->IsStackable())
+	{
+		// Somehow the items quantity went over the max stack size. This shouldn't ever happen
+		ensure(AddAmount <= Item->GetMaxStackSize());
+
+		if (ExistingStackQuantity != INDEX_NONE)
+		{
+			if (ExistingStackQuantity < Item->GetMaxStackSize())
+			{
+				// Find out how much of the item to add
+				const int32 CapacityMaxAddAmount = Item->GetMaxStackSize() - ExistingStackQuantity;
+				int32 ActualAddAmount = FMath::Min(AddAmount, CapacityMaxAddAmount);
+
+				FText ErrorText = LOCTEXT("InventoryErrorText", "Couldn't add all of the items to your inventory.");
+
+				// Adjust based on how much weight we can carry
+				if (!FMath::IsNearlyZero(Item->GetWeight()))
+				{
+					// Find the maximum amount of the item we could take due to weight
+					const int32 WeightMaxAddAmount = FMath::FloorToInt((WeightCapacity - CurrentWeight) / Item->GetWeight());
+					ActualAddAmount = FMath::Min(ActualAddAmount, WeightMaxAddAmount);
+
+					if (ActualAddAmount < AddAmount)
+					{
+						ErrorText = FText::Format(LOCTEXT("InventoryTooMuchWeightText", "Couldn't add entire stack of {ItemName} to Inventory."), Item->GetDisplayName());
+					}
+				}
+				else if (ActualAddAmount < AddAmount)
+				{
+					// If the item weighs none an we can take it, then there was a capacity issue
+					ErrorText = FText::Format(LOCTEXT("InventoryCapacityFullText", "Couldn't add the entire stack of {ItemName} to Inventory. Inventory is Full."), Item->GetDisplayName());
+				}
+				if (ActualAddAmount <= 0)
+				{
+					return FItemAddResult::AddedNone(AddAmount, LOCTEXT("InventoryErrorText", "Couldn't add item to inventory."));
+				}
+
+				if (ActualAddAmount < AddAmount)
+				{
+					return FItemAddResult::AddedSome(AddAmount, ActualAddAmount, ErrorText);
+				}
+				else
+				{
+					return FItemAddResult::AddedAll(AddAmount);
+				}
+			}
+			else
+			{
+				return FItemAddResult::AddedNone(AddAmount, FText::Format(LOCTEXT("InventoryFullStackText", "Couldn't add {ItemName}. You already have a full stack of this item."), Item->GetDisplayName()));
+			}
+		}
+		else
+		{
+			/** Since we don't have any of this item, we'll add the full stack */
+			return FItemAddResult::AddedAll(AddAmount);
+		}
+	}
+	else // item is non-stackable
+	{
+		// Non-stackable items should always have a quantity of 1
+		ensure(AddAmount == 1);
+
+		return FItemAddResult::AddedAll(AddAmount);
+	}
+}
+
+FItemAddResult UInventoryComponent::TryAddItem_Internal(class UItem* Item, const bool bTakeOwnership /*= false*/)
+{
+	if (GetOwner() && GetOwner()->HasAuthority())
+	{
+		const int32 AddAmount = Item->GetQuantity();
+
+		if (Item->OwningInventory == this)
+		{
+			return FItemAddResult::AddedNone(AddAmount, LOCTEXT("InventoryAlreadyHasItemText", "Couldn't add the item to Inventory. It is already in this Inventory"));
+		}
+
+		UItem* ExistingItem = Item->IsStackable() ? FindItem(Item) : nullptr;
+		const FItemAddResult AddResult = PlanItemAdd(Item, AddAmount, Items.Num(), GetCurrentWeight(), ExistingItem ? ExistingItem->GetQuantity() : INDEX_NONE);
+
+		if (AddResult.ActualAmountGiven > 0)
+		{
+			if (ExistingItem)
+			{
+				ExistingItem->SetQuantity(ExistingItem->GetQuantity() + AddResult.ActualAmountGiven);
+
+				// If somehow we get more of the item than the max stack size then something is wrong with our math
+				ensure(ExistingItem->GetQuantity() <= ExistingItem->GetMaxStackSize());
+			}
+			else
+			{
+				bTakeOwnership ? AdoptItem(Item) : AddItem(Item);
+			}
+		}
+
+		return AddResult;
+	}
+
+	//AddItem should never be called on a client.
+	check(false);
+	return FItemAddResult::AddedNone(-1, LOCTEXT("ErrorMessage", ""));
+}
+
+TArray<FItemAddResult> UInventoryComponent::TryAddItemsFromClass(const TArray<FItemClassQuantity>& ItemsToAdd, const bool bAllOrNothing)
+{
+	TArray<FItemAddResult> Results;
+
+	if (!GetOwner() || !GetOwner()->HasAuthority())
+	{
+		return Results;
+	}
+
+	Results.Reserve(ItemsToAdd.Num());
+
+	// Plan the whole batch first. Each entry is checked against the inventory as it would be after every entry before it
+	int32 PlannedSlots = Items.Num();
+	float PlannedWeight = GetCurrentWeight();
+
+	// Every stack the batch adds to, existing or new, in the order they're first added to
+	struct FPlannedStack
+	{
+		TSubclassOf<UItem> ItemClass;
+
+		// The stack we already have, or null for a new one
+		UItem* ExistingItem;
+
+		int32 Quantity;
+		int32 AddedQuantity;
+	};
+
+	TArray<FPlannedStack> PlannedStacks;
+
+	// The stack of each stackable class that's being filled up, as an index into PlannedStacks
+	TMap<UClass*, int32> OpenStacks;
+	bool bAddedEverything = true;
+
+	for (const FItemClassQuantity& Entry : ItemsToAdd)
+	{
+		const UItem* ItemCDO = Entry.ItemClass ? Entry.ItemClass->GetDefaultObject<UItem>() : nullptr;
+
+		if (!ItemCDO || Entry.Quantity <= 0)
+		{
+			Results.Add(FItemAddResult::AddedNone(Entry.Quantity, LOCTEXT("InventoryInvalidItemText", "Couldn't add the item to Inventory.")));
+			bAddedEverything = false;
+			continue;
+		}
+
+		const bool bStackable = ItemCDO->IsStackable();
+		const int32 MaxStackSize = ItemCDO->GetMaxStackSize();
+
+		// The first time we see a class, top up a stack we already have if there's one with room in it
+		if (bStackable && !OpenStacks.Contains(Entry.ItemClass))
+		{
+			if (const FIndexedStacks* IndexedStacks = FindIndexedStacks(Entry.ItemClass))
+			{
+				for (UItem* Stack : IndexedStacks->Stacks)
+				{
+					if (Stack->GetQuantity() < MaxStackSize)
+					{
+						OpenStacks.Add(Entry.ItemClass, PlannedStacks.Add({ Entry.ItemClass, Stack, Stack->GetQuantity(), 0 }));
+						break;
+					}
+				}
+			}
+		}
+
+		int32 AmountGiven = 0;
+		FText ErrorText;
+
+		// One stack's worth at a time, so each goes through the same checks a single add would
+		while (AmountGiven < Entry.Quantity)
+		{
+			const int32* OpenStackIndex = bStackable ? OpenStacks.Find(Entry.ItemClass) : nullptr;
+			int32 StackIndex = OpenStackIndex && PlannedStacks[*OpenStackIndex].Quantity < MaxStackSize ? *OpenStackIndex : INDEX_NONE;
+
+			int32 ChunkAmount = FMath::Min(Entry.Quantity - AmountGiven, MaxStackSize);
+
+			// PlanItemAdd() only checks a new stack has room for one more of the item, so keep whole chunks within the weight left.
+			// At least one, so an item that doesn't fit at all still gets its error from there
+			if (!FMath::IsNearlyZero(ItemCDO->GetWeight()))
+			{
+				ChunkAmount = FMath::Min(ChunkAmount, FMath::Max(FMath::FloorToInt((GetWeightCapacity() - PlannedWeight) / ItemCDO->GetWeight()), 1));
+			}
+			const FItemAddResult ChunkResult = PlanItemAdd(ItemCDO, ChunkAmount, PlannedSlots, PlannedWeight, StackIndex != INDEX_NONE ? PlannedStacks[StackIndex].Quantity : INDEX_NONE);
+
+			if (ChunkResult.ActualAmountGiven <= 0)
+			{
+				ErrorText = ChunkResult.ErrorText;
+				break;
+			}
+
+			if (StackIndex == INDEX_NONE)
+			{
+				StackIndex = PlannedStacks.Add({ Entry.ItemClass, nullptr, 0, 0 });
+				++PlannedSlots;
+
+				if (bStackable)
+				{
+					OpenStacks.Add(Entry.ItemClass, StackIndex);
+				}
+			}
+
+			FPlannedStack& PlannedStack = PlannedStacks[StackIndex];
+			PlannedStack.Quantity += ChunkResult.ActualAmountGiven;
+			PlannedStack.AddedQuantity += ChunkResult.ActualAmountGiven;
+
+			PlannedWeight += ChunkResult.ActualAmountGiven * ItemCDO->GetWeight();
+			AmountGiven += ChunkResult.ActualAmountGiven;
+
+			// Falling short because the stack filled up just means the rest goes into a new one. Anything else is weight
+			if (ChunkResult.ActualAmountGiven < ChunkAmount && PlannedStack.Quantity < MaxStackSize)
+			{
+				ErrorText = ChunkResult.ErrorText;
+				break;
+			}
+		}
+
+		if (AmountGiven >= Entry.Quantity)
+		{
+			Results.Add(FItemAddResult::AddedAll(Entry.Quantity));
+		}
+		else
+		{
+			Results.Add(AmountGiven > 0 ? FItemAddResult::AddedSome(Entry.Quantity, AmountGiven, ErrorText) : FItemAddResult::AddedNone(Entry.Quantity, ErrorText));
+			bAddedEverything = false;
+		}
+	}
+
+	if (bAllOrNothing && !bAddedEverything)
+	{
+		for (int32 i = 0; i < Results.Num(); ++i)
+		{
+			const FText ErrorText = Results[i].ActualAmountGiven < ItemsToAdd[i].Quantity ? Results[i].ErrorText : LOCTEXT("InventoryBatchFailedText", "Couldn't add the items to Inventory. Not all of them would fit.");
+			Results[i] = FItemAddResult::AddedNone(ItemsToAdd[i].Quantity, ErrorText);
+		}
+
+		return Results;
+	}
+
+	// Then apply it, stack by stack
+	FInventoryBatchScope Batch(this);
+
+	for (const FPlannedStack& PlannedStack : PlannedStacks)
+	{
+		if (PlannedStack.AddedQuantity <= 0)
+		{
+			continue;
+		}
+
+		if (PlannedStack.ExistingItem)
+		{
+			PlannedStack.ExistingItem->SetQuantity(PlannedStack.ExistingItem->GetQuantity() + PlannedStack.AddedQuantity);
+		}
+		else
+		{
+			UItem* NewItem = UItemPool::CreateItem(GetOwner(), PlannedStack.ItemClass);
+			NewItem->SetQuantity(PlannedStack.AddedQuantity);
+			InsertItem(NewItem);
+		}
+	}
+
+	return Results;
+}
+
+int32 UInventoryComponent::ConsumeItem(class UItem* Item, const int32 Quantity)
+{
+	if (GetOwner() && GetOwner()->HasAuthority() && Item)
+	{
+		const int32 RemoveQuantity = FMath::Min(Quantity, Item->GetQuantity());
+
+		// We shouldn't have a negative amount of the item after the drop
+		ensure(!(Item->GetQuantity() - RemoveQuantity < 0));
+
+		// We now have zero of this item, remove it from the inventory
+		Item->SetQuantity(Item->GetQuantity() - RemoveQuantity);
+
+		// Clients find out about the new quantity when it replicates, so there's no need to tell them here
+		if (Item->GetQuantity() <= 0)
+		{
+			RemoveItem(Item);
+		}
+
+		return RemoveQuantity;
+	}
+	
+	return 0;
+}
+
+int32 UInventoryComponent::ConsumeItem(class UItem* Item)
+{
+	if (Item)
 	{
 		ConsumeItem(Item, Item->GetQuantity());
 	}
 	return 0;
 }
 
+TArray<int32> UInventoryComponent::ConsumeItemsByClass(const TArray<FItemClassQuantity>& ItemsToConsume, const bool bAllOrNothing)
+{
+	TArray<int32> AmountsConsumed;
+	AmountsConsumed.SetNumZeroed(ItemsToConsume.Num());
+
+	if (!GetOwner() || !GetOwner()->HasAuthority())
+	{
+		return AmountsConsumed;
+	}
+
+	if (bAllOrNothing)
+	{
+		// The same class can be listed more than once, so check against what the earlier entries would leave us with
+		TMap<UClass*, int32> PlannedQuantities;
+
+		for (const FItemClassQuantity& Entry : ItemsToConsume)
+		{
+			int32* PlannedQuantity = PlannedQuantities.Find(Entry.ItemClass);
+
+			if (!PlannedQuantity)
+			{
+				PlannedQuantity = &PlannedQuantities.Add(Entry.ItemClass, GetItemQuantity(Entry.ItemClass));
+			}
+
+			*PlannedQuantity -= FMath::Max(Entry.Quantity, 0);
+
+			if (*PlannedQuantity < 0)
+			{
+				return AmountsConsumed;
+			}
+		}
+	}
+
+	FInventoryBatchScope Batch(this);
+
+	for (int32 i = 0; i < ItemsToConsume.Num(); ++i)
+	{
+		int32 RemainingQuantity = ItemsToConsume[i].Quantity;
+
+		while (RemainingQuantity > 0)
+		{
+			UItem* Stack = FindItemByClass(ItemsToConsume[i].ItemClass);
+
+			if (!Stack)
+			{
+				break;
+			}
+
+			const int32 Consumed = ConsumeItem(Stack, RemainingQuantity);
+
+			RemainingQuantity -= Consumed;
+			AmountsConsumed[i] += Consumed;
+
+			if (Consumed <= 0)
+			{
+				break;
+			}
+		}
+	}
+
+	return AmountsConsumed;
+}
+
+int32 UInventoryComponent::RemoveItems(const TArray<class UItem*>& ItemsToRemove)
+{
+	FInventoryBatchScope Batch(this);
+
+	int32 NumRemoved = 0;
+
+	for (UItem* Item : ItemsToRemove)
+	{
+		if (RemoveItem(Item))
+		{
+			++NumRemoved;
+		}
+	}
+
+	return NumRemoved;
+}
+
 #undef LOCTEXT_NAMESPACE
\ No newline at end of file
@@ -6,11 +6,15 @@
 #include "Items/Item.h"
 #include "Delegates/Delegate.h"
 #include "Components/ActorComponent.h"
+#include "Engine/NetSerialization.h"
 #include "InventoryComponent.generated.h"
 
 // Called when the inventory is changed and the UI needs an update . 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnInventoryUpdated);
 
+// Called when the inventory totals (weight, used slots, quantities) change
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnInventoryAggregatesChanged);
+
 
 UENUM(BlueprintType)
 enum class EItemAddResult : uint8
@@ -77,6 +81,160 @@ public:
 	}
 };
 
+//An item class and how many of it, used by the bulk inventory functions ie for loot crates, recipes and respawn kits
+USTRUCT(BlueprintType)
+struct FItemClassQuantity
+{
+	GENERATED_BODY()
+
+public:
+
+	FItemClassQuantity() : Quantity(1) {};
+	FItemClassQuantity(TSubclassOf<class UItem> InItemClass, const int32 InQuantity) : ItemClass(InItemClass), Quantity(InQuantity) {};
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Item Class Quantity")
+	TSubclassOf<class UItem> ItemClass;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Item Class Quantity", meta = (ClampMin = 1))
+	int32 Quantity;
+};
+
+
+//Running totals over every item in an inventory. Kept up to date as items are added, removed or change quantity, so reading them is free.
+USTRUCT(BlueprintType)
+struct FInventoryAggregates
+{
+	GENERATED_BODY()
+
+public:
+
+	FInventoryAggregates() : TotalWeight(0.f), NumSlots(0) {};
+
+	// The combined weight of every item in the inventory
+	UPROPERTY(BlueprintReadOnly, Category = "Inventory Aggregates")
+	float TotalWeight;
+
+	// The number of inventory slots in use
+	UPROPERTY(BlueprintReadOnly, Category = "Inventory Aggregates")
+	int32 NumSlots;
+
+	// The total quantity of items of each rarity
+	UPROPERTY(BlueprintReadOnly, Category = "Inventory Aggregates")
+	TMap<EItemRarity, int32> QuantityByRarity;
+};
+
+
+UENUM(BlueprintType)
+enum class EInventoryReplicationMode : uint8
+{
+	// Replicate Items as a plain array, and check every item subobject whenever ReplicatedItemsKey changes
+	IRM_RepKey UMETA(DisplayName = "Rep Key"),
+	// Replicate items through a fast array, so only the entries and item subobjects that changed are sent and checked
+	IRM_FastArray UMETA(DisplayName = "Fast Array")
+};
+
+UENUM(BlueprintType)
+enum class EInventoryReplicationPolicy : uint8
+{
+	// Every relevant client gets the whole inventory
+	IRP_Everyone UMETA(DisplayName = "Everyone"),
+	// Only the owning client gets the whole inventory. Use this for player inventories
+	IRP_OwnerOnly UMETA(DisplayName = "Owner Only"),
+	// The owning client and any viewers (ie players with a container open) get the whole inventory
+	IRP_ViewersOnly UMETA(DisplayName = "Viewers Only")
+};
+
+//A single replicated inventory entry, used when the inventory replicates in IRM_FastArray mode
+USTRUCT()
+struct FInventoryEntry : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+public:
+
+	FInventoryEntry() : Item(nullptr) {};
+	FInventoryEntry(class UItem* InItem) : Item(InItem) {};
+
+	// The item in this slot. Its properties replicate as a subobject of the inventory owner.
+	UPROPERTY()
+	class UItem* Item;
+
+	// Client side callbacks, called by the fast array when this entry is replicated
+	void PreReplicatedRemove(const struct FInventoryEntryArray& InArraySerializer);
+	void PostReplicatedAdd(const struct FInventoryEntryArray& InArraySerializer);
+	void PostReplicatedChange(const struct FInventoryEntryArray& InArraySerializer);
+};
+
+USTRUCT()
+struct FInventoryEntryArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+public:
+
+	FInventoryEntryArray() : OwnerInventory(nullptr), bFiltered(false) {};
+
+	UPROPERTY()
+	TArray<FInventoryEntry> Entries;
+
+	// The inventory these entries belong to. Deliberately not a UPROPERTY so it isn't copied from the archetype.
+	class UInventoryComponent* OwnerInventory;
+
+	/** Set on the lists that only hold some of the items, ie the public summary and viewer lists. Clients rebuild Items from these
+	as a whole rather than one entry at a time, since an item can leave one of them while it's still in another */
+	bool bFiltered;
+
+	// [Server] Make the entries hold exactly the given items. Only the entries that were added or removed are sent
+	void SyncEntries(const TArray<class UItem*>& NewItems);
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FInventoryEntry, FInventoryEntryArray>(Entries, DeltaParms, *this);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FInventoryEntryArray> : public TStructOpsTypeTraitsBase2<FInventoryEntryArray>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
+
+/**
+ * The whole item list of an IRP_ViewersOnly inventory, as one viewer sees it. Each viewer gets their own, replicated only through
+ * their own connection, so nobody else ever learns what's in the inventory. When the viewer is removed the list is emptied and
+ * sent once more, which is how their client knows to go back to the public summary. A fast array, so only what changed is sent.
+ */
+UCLASS()
+class SURVIVALGAME_API UInventoryViewerList : public UObject
+{
+	GENERATED_BODY()
+
+public:
+
+	UInventoryViewerList();
+
+	virtual bool IsSupportedForNetworking() const override { return true; };
+	virtual void GetLifetimeReplicatedProps(TArray<class FLifetimeProperty>& OutLifetimeProps) const override;
+
+	UPROPERTY(ReplicatedUsing = OnRep_ViewerList)
+	class UInventoryComponent* Inventory;
+
+	// Whether the viewer can still see the inventory. Items is empty when this isn't set
+	UPROPERTY(ReplicatedUsing = OnRep_ViewerList)
+	bool bViewing;
+
+	UPROPERTY(Replicated)
+	FInventoryEntryArray Entries;
+
+	// [Server] Who this list is for
+	TWeakObjectPtr<class APlayerController> Viewer;
+
+	UFUNCTION()
+	void OnRep_ViewerList();
+};
 
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
 class SURVIVALGAME_API UInventoryComponent : public UActorComponent
@@ -84,6 +242,9 @@ class SURVIVALGAME_API UInventoryComponent : public UActorComponent
 	GENERATED_BODY()
 
 		friend class UItem;
+		friend struct FInventoryEntry;
+		friend struct FInventoryBatchScope;
+		friend class UInventoryViewerList;
 
 public:	
 	// Sets default values for this component's properties
@@ -106,14 +267,48 @@ public:
 	int32 ConsumeItem(class UItem* Item);
 	int32 ConsumeItem(class UItem* Item, const int32 Quantity);
 
-	/** Remove the item from the inventory */
+	/** Add many items at once. The whole batch is planned against capacity and weight before anything is added, as if the entries were
+	added one after another. Unlike TryAddItemFromClass(), an entry can be more than one stack: it tops up a stack we already have that
+	isn't full, then goes into as many new stacks as it needs. Each result is against the entry's full quantity.
+	@param bAllOrNothing if set and any entry can't be added in full, nothing is added at all
+	@return one result per entry in ItemsToAdd */
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+	TArray<FItemAddResult> TryAddItemsFromClass(const TArray<FItemClassQuantity>& ItemsToAdd, const bool bAllOrNothing);
+
+	/** Take the given quantities away from the inventory, across as many stacks of each class as it takes.
+	@param bAllOrNothing if set and we don't have enough of every entry, nothing is consumed at all. Use this for crafting recipes
+	@return the amount consumed for each entry in ItemsToConsume */
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+	TArray<int32> ConsumeItemsByClass(const TArray<FItemClassQuantity>& ItemsToConsume, const bool bAllOrNothing);
+
+	/** Remove many items at once. Returns how many of them were in this inventory */
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+	int32 RemoveItems(const TArray<class UItem*>& ItemsToRemove);
+
+	/** Move an item into this inventory without copying it where possible. The item is taken out of the inventory that held it, if any.
+	If it can't be moved over as a whole stack it is merged into one of our stacks instead, and the amount given is taken from the source inventory.
+	Items that have already been replicated are moved as a fresh copy (see UItem::MoveToOuter()), in which case the item passed in ends up in no inventory.
+	Pickups and other non-inventory owners must clear their own reference if the item ends up owned by this inventory, and drop it if all of it was given.
+	@return the amount of the item that was added to the inventory */
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+	FItemAddResult TryTransferItem(class UItem* Item);
+
+	/** Remove the item from the inventory. Returns false if the item wasn't in this inventory. The item itself is left as it is and never
+	pooled, so callers can keep using it or hand it to a pickup */
 	UFUNCTION(BlueprintCallable, Category = "Inventory")
 	bool RemoveItem(class UItem *Item);
 
-	/** Return true if we have a given amount of an item */
+	/** Return true if we have a given amount of an item, counting every stack of that class */
 	UFUNCTION(BlueprintCallable, Category = "Inventory")
 	bool HasItem(TSubclassOf<UItem> ItemClass, const int32 Quantity = 1) const;
 
+	/** Return the total quantity we have of an item class, summed over all of its stacks */
+	UFUNCTION(BlueprintPure, Category = "Inventory")
+	int32 GetItemQuantity(TSubclassOf<UItem> ItemClass) const;
+
+	/** Same as GetItemQuantity(), using the catalog ID of the item */
+	int32 GetItemQuantityById(const FItemId ItemId) const;
+
 	/** Return the first item with the same class as a given Item */
 	UFUNCTION(BlueprintCallable, Category = "Inventory")
 	UItem *FindItem(class UItem *Item) const;
@@ -122,12 +317,25 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Inventory")
 	UItem *FindItemByClass (TSubclassOf<UItem> ItemClass) const;
 
+	/** Return the first item with the given catalog ID */
+	UItem* FindItemById(const FItemId ItemId) const;
+
 	/** Get all inventory items that are a child of ItemClass. Useful for grabbing all weapons, all food, etc.  */
 	UFUNCTION(BlueprintCallable, Category = "Inventory")
 	TArray<UItem*> FindItemsByClass(TSubclassOf<UItem> ItemClass) const;
 
-	UFUNCTION(BlueprintCallable, Category = "Inventory")
-	float GetCurrentWeight() const;
+	UFUNCTION(BlueprintPure, Category = "Inventory")
+	FORCEINLINE float GetCurrentWeight() const { return Aggregates.TotalWeight; };
+
+	UFUNCTION(BlueprintPure, Category = "Inventory")
+	FORCEINLINE int32 GetNumSlotsUsed() const { return Aggregates.NumSlots; };
+
+	/** Return the total quantity of every item of the given rarity */
+	UFUNCTION(BlueprintPure, Category = "Inventory")
+	int32 GetRarityQuantity(const EItemRarity Rarity) const;
+
+	UFUNCTION(BlueprintPure, Category = "Inventory")
+	FORCEINLINE FInventoryAggregates GetAggregates() const { return Aggregates; };
 
 	UFUNCTION(BlueprintCallable, Category = "Inventory")
 	void SetWeightCapacity(const float NewWeightCapacity);
@@ -144,12 +352,30 @@ public:
 	UFUNCTION(BlueprintPure, Category = "Inventory")
 	FORCEINLINE TArray<class UItem*> GetItems() const {return Items; };
 
+	/** [Server] Change who the inventory replicates to. See EInventoryReplicationPolicy */
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Replication")
+	void SetReplicationPolicy(const EInventoryReplicationPolicy NewPolicy, const bool bNewReplicatePublicSummary);
+
+	/** [Server] Let a player see the whole inventory while the policy is IRP_ViewersOnly, ie when they open a container. Viewers are
+	dropped if the policy changes to anything else */
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Replication")
+	void AddViewer(class APlayerController* Viewer);
+
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Replication")
+	void RemoveViewer(class APlayerController* Viewer);
+
+	/** Force the owning client to refresh its inventory UI. Normal changes don't need this, clients pick them up from replication */
 	UFUNCTION(Client, Reliable)
 	void ClientRefreshInventory();
 
+	/** Broadcast at most once a frame, after every change made that frame, or when the outermost FInventoryBatchScope ends */
 	UPROPERTY(BlueprintAssignable, Category = "Inventory")
 	FOnInventoryUpdated OnInventoryUpdated;
 
+	// Broadcast on the server and clients whenever the weight, used slots or quantities change. Coalesced the same way as OnInventoryUpdated.
+	UPROPERTY(BlueprintAssignable, Category = "Inventory")
+	FOnInventoryAggregatesChanged OnAggregatesChanged;
+
 protected:
 
 
@@ -161,10 +387,38 @@ protected:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Inventory", meta = (ClampMin = 0, ClampMax = 200))
 	int32 Capacity;
 
+	// How the items are sent to clients. Fast Array only sends what changed, Rep Key is the older path and is kept to compare against.
+	UPROPERTY(EditDefaultsOnly, Category = "Inventory|Replication")
+	EInventoryReplicationMode ReplicationMode;
+
+	// Who gets the whole inventory. Everyone else gets nothing, or the public summary if bReplicatePublicSummary is set
+	UPROPERTY(EditDefaultsOnly, ReplicatedUsing = OnRep_ReplicationPolicy, Category = "Inventory|Replication")
+	EInventoryReplicationPolicy ReplicationPolicy;
+
+	// If set, clients that don't get the whole inventory still get the items that are visible to everyone, ie equipped gear
+	UPROPERTY(EditDefaultsOnly, Category = "Inventory|Replication")
+	bool bReplicatePublicSummary;
+
+	// Replicated to the owner only in IRM_RepKey mode. In IRM_FastArray mode clients build this from whichever entries they get, so it can always be read.
 	UPROPERTY(ReplicatedUsing = OnRep_Items, VisibleAnywhere, Category = "Inventory")
 	TArray<class UItem*> Items;
 
+	/** Mirrors Items on the server in IRM_FastArray mode. Replicated to every client under IRP_Everyone. Under the other policies the
+	entries live in OwnerItemEntries instead, which only the owner gets. SetReplicationPolicy() moves them between the two */
+	UPROPERTY(Replicated)
+	FInventoryEntryArray ItemEntries;
+
+	UPROPERTY(Replicated)
+	FInventoryEntryArray OwnerItemEntries;
+
+	/** What clients other than the owner get under IRP_OwnerOnly and IRP_ViewersOnly: the public summary, if bReplicatePublicSummary is set.
+	Viewers of an IRP_ViewersOnly inventory get the whole list through their own UInventoryViewerList instead. In IRM_RepKey mode this
+	also carries all of Items to non-owners under IRP_Everyone */
+	UPROPERTY(Replicated)
+	FInventoryEntryArray SummaryEntries;
+
 	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
 	virtual bool ReplicateSubobjects(class UActorChannel* Channel, class FOutBunch* Bunch, FReplicationFlags* RepFlags) override;
 
 
@@ -173,12 +427,162 @@ private:
 	/** Don't call Items.Add() directly, use this function instead, as it handles replication and ownership */
 	UItem* AddItem(class UItem* Item);
 
+	/** Like AddItem(), but moves the given item into this inventory instead of adding a copy of it, unless it has been replicated.
+	Returns the item that was added */
+	UItem* AdoptItem(class UItem* Item);
+
+	/** Add an item we already own to Items, the entries and the lookup tables. Used by AddItem() and AdoptItem() */
+	void InsertItem(class UItem* Item);
+
+	// [Server] Where Items is mirrored in IRM_FastArray mode under the current policy, ItemEntries or OwnerItemEntries
+	FInventoryEntryArray& GetItemEntries();
+
 	UFUNCTION()
 	void OnRep_Items();
 
+	UFUNCTION()
+	void OnRep_ReplicationPolicy();
+
+	// [Server] One list for every player that can see, or could recently see, the whole inventory under IRP_ViewersOnly
+	UPROPERTY(Transient)
+	TArray<UInventoryViewerList*> ViewerLists;
+
+	// [Client] Our viewer list, if the server has ever sent us one
+	UPROPERTY(Transient)
+	UInventoryViewerList* ClientViewerList;
+
+	class UInventoryViewerList* FindViewerList(const class UNetConnection* Connection) const;
+
+	/** [Client] Build Items from the entries we get: ItemEntries under IRP_Everyone, otherwise OwnerItemEntries if we're the owner,
+	or our viewer list while we're a viewer, or SummaryEntries */
+	void RebuildClientItems();
+
+	// [Client] Called when a filtered list changes. Items is rebuilt once, when notifications are next flushed
+	void OnFilteredEntriesChanged();
+	bool bClientItemsDirty;
+
+	// Set when the summary and viewer lists need syncing, which is done at most once per net update in PreReplication()
+	bool bSharedItemsDirty;
+
+	void RebuildSharedItems();
+
+	// How much of the inventory a channel is allowed to see
+	enum class EItemAccess : uint8 { None, Summary, Full };
+	EItemAccess GetItemAccess(class UActorChannel* Channel, const FReplicationFlags* RepFlags) const;
+	bool CanReplicateItemTo(const class UItem* Item, const EItemAccess Access) const;
+
+	// Make every channel check all of the items again, ie when what they're allowed to see has changed
+	void ResetItemReplication();
+
 	UPROPERTY()
 	int32 ReplicatedItemsKey;
 
+	/** [Server] Called by items when they need re-replicating. Bumps ReplicatedItemsKey, and in IRM_FastArray mode marks the item's entry dirty */
+	void MarkItemDirty(class UItem* Item);
+
+	/** [Client] Fast array callbacks, keep Items and the lookup tables in sync with the replicated entries */
+	void OnEntryAdded(class UItem* Item);
+	void OnEntryRemoved(class UItem* Item);
+	void OnEntryChanged(class UItem* Item);
+
+	bool ReplicateAllItems(class UActorChannel* Channel, class FOutBunch* Bunch, FReplicationFlags* RepFlags, const EItemAccess Access);
+	bool ReplicateDirtyItems(class UActorChannel* Channel, class FOutBunch* Bunch, FReplicationFlags* RepFlags, const EItemAccess Access);
+
+	/** In IRM_FastArray mode, every item that was marked dirty in the order it happened. DirtyItemLogStart is the
+	generation of the first entry, and each channel remembers the generation it has replicated up to. That way a
+	channel only has to look at what changed since it last replicated instead of every item in the inventory. */
+	TArray<TWeakObjectPtr<UItem>> DirtyItemLog;
+	int32 DirtyItemLogStart;
+	TMap<TWeakObjectPtr<class UActorChannel>, int32> ChannelItemGenerations;
+
+	/** Work out how much of an item could be added, without changing anything. Shared by the single and bulk add functions so they follow the same rules.
+	@param SlotsUsed, CurrentWeight the state of the inventory to plan against, which for a bulk add includes everything planned before this item
+	@param ExistingStackQuantity the quantity of the stack the item would be merged into, or INDEX_NONE to add it as a new stack */
+	FItemAddResult PlanItemAdd(const class UItem* Item, const int32 AddAmount, const int32 SlotsUsed, const float CurrentWeight, const int32 ExistingStackQuantity) const;
+
 	// Internal, non-BP exposed add item function. Don't call this directly, use TryAddItem(), or TryAddItemFromClass() instead.
-	FItemAddResult TryAddItem_Internal(class UItem* Item);
+	// If bTakeOwnership is set, the item itself is moved into the inventory when it can be, instead of a copy of it
+	FItemAddResult TryAddItem_Internal(class UItem* Item, const bool bTakeOwnership = false);
+
+	/** Lookup tables kept in sync with Items, so queries don't have to scan the whole inventory.
+	These don't need to be UPROPERTYs since every item in them is also referenced by Items. */
+
+	// Every stack of one exact item class, in the order they were added, and their total quantity
+	struct FIndexedStacks
+	{
+		FIndexedStacks() : Quantity(0) {};
+
+		TArray<UItem*> Stacks;
+		int32 Quantity;
+	};
+
+	// Stacks by the catalog ID of their class, which hashes and compares cheaper than the class itself
+	TMap<FItemId, FIndexedStacks> StacksById;
+
+	// Stacks of classes that aren't in the catalog, so have no ID to be filed under
+	TMap<UClass*, FIndexedStacks> StacksByUncataloguedClass;
+
+	// Every stack of this class or any of its children. Backs FindItemsByClass(), which is about class hierarchy rather than exact items
+	TMap<UClass*, TArray<UItem*>> ItemsByParentClass;
+
+	// Where the stacks of an item class, or of an item's class, are filed
+	const FIndexedStacks* FindIndexedStacks(const UClass* ItemClass) const;
+	FIndexedStacks* FindIndexedStacks(const class UItem* Item);
+	FIndexedStacks& FindOrAddIndexedStacks(const class UItem* Item);
+	void RemoveIndexedStacks(const class UItem* Item);
+
+	// Running totals, updated alongside the lookup tables
+	FInventoryAggregates Aggregates;
+
+	// True if the item is in the lookup tables, cheaper than searching Items
+	bool IsItemIndexed(class UItem* Item) const;
+
+	/** Add/remove an item to/from the lookup tables. Call these whenever Items is changed, then ValidateItemIndex() */
+	void IndexItem(class UItem* Item);
+	void UnindexItem(class UItem* Item);
+
+	/** Throw away the lookup tables and build them again from Items. Used on clients when Items is replicated */
+	void RebuildItemIndex();
+
+	/** Called by items in this inventory when their quantity changes, so the quantity totals and weight stay correct */
+	void OnItemQuantityChanged(class UItem* Item, const int32 OldQuantity);
+
+	/** Check the lookup tables and aggregates against a full scan of Items. Does nothing unless SurvivalGame.Inventory.ValidateIndex is set */
+	void ValidateItemIndex() const;
+
+	/** Queue OnInventoryUpdated, and OnAggregatesChanged if bAggregatesChanged, instead of broadcasting them straight away.
+	Every change made in the same frame, or inside the same batch, results in a single broadcast of each. */
+	void MarkInventoryDirty(const bool bAggregatesChanged);
+
+	/** Broadcast whatever is pending. Runs on the next tick, or when the outermost batch ends */
+	void FlushInventoryNotifications();
+
+	bool bInventoryUpdatePending;
+	bool bAggregatesChangePending;
+	bool bFlushScheduled;
+
+	// How many FInventoryBatchScopes are open on this inventory. Notifications are held back until this goes back to zero
+	int32 BatchDepth;
+};
+
+/** Groups several changes to an inventory together, so listeners hear about them once when the scope ends instead of after each one:
+
+	{
+		FInventoryBatchScope Batch(Inventory);
+		Inventory->TryAddItemFromClass(...);
+		Inventory->ConsumeItem(...);
+	}
+
+Scopes can be nested, only the outermost one flushes. */
+struct SURVIVALGAME_API FInventoryBatchScope
+{
+	explicit FInventoryBatchScope(class UInventoryComponent* InInventory);
+	~FInventoryBatchScope();
+
+private:
+
+	TWeakObjectPtr<class UInventoryComponent> Inventory;
+
+	FInventoryBatchScope(const FInventoryBatchScope&) = delete;
+	FInventoryBatchScope& operator=(const FInventoryBatchScope&) = delete;
 };
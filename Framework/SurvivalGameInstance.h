@@ -13,5 +13,15 @@ UCLASS()
 class SURVIVALGAME_API USurvivalGameInstance : public UGameInstance
 {
 	GENERATED_BODY()
+
+public:
+
+	FORCEINLINE class UItemCatalog* GetItemCatalog() const { return ItemCatalog; };
+
+protected:
+
+	// Gives every item class a compact ID for replication, save games and loot tables. Referenced here so it's always loaded and cooked
+	UPROPERTY(EditDefaultsOnly, Category = "Items")
+	class UItemCatalog* ItemCatalog;
 	
 };
@@ -13,5 +13,11 @@ UCLASS()
 class SURVIVALGAME_API ASurvivalGameStateBase : public AGameStateBase
 {
 	GENERATED_BODY()
+
+public:
+
+	// The world's pickup manager, set by the manager itself when it begins play on the server and on clients
+	UPROPERTY(Transient)
+	class APickupManager* PickupManager;
 	
 };
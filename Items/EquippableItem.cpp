@@ -10,9 +10,19 @@
 
 UEquippableItem::UEquippableItem()
 {
-	bStackable = false;
 	bEquipped = false;
-	UseActionText = LOCTEXT("ItemActionText", "Equip");
+}
+
+FText UEquippableItem::GetUseActionText() const
+{
+	const FText& UseActionText = GetDefinition()->UseActionText;
+	return UseActionText.IsEmpty() ? LOCTEXT("ItemActionText", "Equip") : UseActionText;
+}
+
+bool UEquippableItem::IsStackable() const
+{
+	// Equippables are never stackable, whatever their definition says
+	return false;
 }
 
 void UEquippableItem::GetLifetimeReplicatedProps(TArray<class FLifetimeProperty>& OutLifetimeProps) const
@@ -36,6 +46,28 @@ void UEquippableItem::Use(class ASurvivalCharacter* Character)
 	}
 }
 
+void UEquippableItem::RemovedFromInventory(class UInventoryComponent* Inventory)
+{
+	// An item can't stay equipped once it has left the characters inventory
+	if (bEquipped)
+	{
+		SetEquipped(false);
+	}
+
+	Super::RemovedFromInventory(Inventory);
+}
+
+void UEquippableItem::ResetItem()
+{
+	// Take the item off the character first, so they aren't left with an equipped item that's sitting in the pool
+	if (bEquipped)
+	{
+		SetEquipped(false);
+	}
+
+	Super::ResetItem();
+}
+
 bool UEquippableItem::Equip(class ASurvivalCharacter* Character)
 {
 	if (Character)
@@ -59,6 +91,12 @@ bool UEquippableItem::ShouldShowInInventory() const
 	return !bEquipped;
 }
 
+bool UEquippableItem::ShouldReplicateInSummary() const
+{
+	// Everyone needs equipped gear to see it on the character
+	return bEquipped;
+}
+
 void UEquippableItem::SetEquipped(bool bNewEquipped)
 {
 	bEquipped = bNewEquipped;
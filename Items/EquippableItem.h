@@ -43,6 +43,11 @@ public:
 
 	virtual void Use(class ASurvivalCharacter* Character) override;
 
+	virtual FText GetUseActionText() const override;
+	virtual bool IsStackable() const override;
+	virtual void RemovedFromInventory(class UInventoryComponent* Inventory) override;
+	virtual void ResetItem() override;
+
 	UFUNCTION(BlueprintCallable, Category = "Equippables")
 	virtual bool Equip(class ASurvivalCharacter *Character);
 
@@ -50,6 +55,7 @@ public:
 	virtual bool UnEquip(class ASurvivalCharacter *Character);
 
 	virtual bool ShouldShowInInventory() const override;
+	virtual bool ShouldReplicateInSummary() const override;
 
 	UFUNCTION(BlueprintPure, Category = "Equippables")
 	bool IsEquipped() {return bEquipped; };
@@ -9,7 +9,12 @@
 UFoodItem::UFoodItem()
 {
 	healAmount = 20.f;
-	UseActionText = LOCTEXT("ItemUseActionText", "Consume");
+}
+
+FText UFoodItem::GetUseActionText() const
+{
+	const FText& UseActionText = GetDefinition()->UseActionText;
+	return UseActionText.IsEmpty() ? LOCTEXT("ItemUseActionText", "Consume") : UseActionText;
 }
 
 void UFoodItem::Use(class ASurvivalCharacter* Character)
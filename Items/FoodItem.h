@@ -23,4 +23,6 @@ public:
 	float healAmount;
 
 	virtual void Use(class ASurvivalCharacter* Character) override;
+
+	virtual FText GetUseActionText() const override;
 };
@@ -3,7 +3,14 @@
 
 #include "Items/Item.h"
 #include "Components/InventoryComponent.h"
+#include "Items/ItemCatalog.h"
+#include "Items/ItemPool.h"
+#include "Engine/World.h"
+#include "Engine/NetDriver.h"
+#include "Engine/DemoNetDriver.h"
+#include "Engine/PackageMapClient.h"
 #include "Net/UnrealNetwork.h"
+#include "UObject/UObjectIterator.h"
 
 
 #define LOCTEXT_NAMESPACE "Item"
@@ -29,24 +36,84 @@ void UItem::PostEditChangeProperty(struct FPropertyChangedEvent& PropertyChanged
 	//UPROPERTY clamping doesn't support using a variable to clamp so we do in here instead
 	if (ChangedPropertyName == GET_MEMBER_NAME_CHECKED(UItem, Quantity))
 	{
-		Quantity = FMath::Clamp(Quantity, 1, bStackable ? MaxStackSize : 1);
+		Quantity = FMath::Clamp(Quantity, 1, GetMaxStackSize());
 	}
 }
 #endif
 
+void UItem::PostLoad()
+{
+	Super::PostLoad();
+
+#if WITH_EDITORONLY_DATA
+	if (NeedsItemDataMigration())
+	{
+		MigrateDeprecatedItemData();
+	}
+#endif
+}
+
 UItem::UItem()
 {
-	ItemDisplayName = LOCTEXT("ItemName", "Item");
-	UseActionText = LOCTEXT("ItemUseActionText", "Use");
-	Weight = 0.f;
-	bStackable = true;
+	Definition = nullptr;
 	Quantity = 1;
-	MaxStackSize = 2;
 	RepKey = 0;
+	bItemIdCached = false;
+
+#if WITH_EDITORONLY_DATA
+	// The defaults these properties had before they were deprecated, so Blueprints that never changed them load the same values.
+	// UseActionText is left empty, which makes each item class fall back to its own default text
+	PickUpMesh_DEPRECATED = nullptr;
+	Thumbnail_DEPRECATED = nullptr;
+	ItemDisplayName_DEPRECATED = LOCTEXT("ItemName", "Item");
+	Rarity_DEPRECATED = EItemRarity::IR_Common;
+	Weight_DEPRECATED = 0.f;
+	bStackable_DEPRECATED = true;
+	MaxStackSize_DEPRECATED = 2;
+#endif
 }
 
-void UItem::OnRep_Quantity()
+FItemId UItem::GetItemIdOfClass(const UClass* ItemClass, const UObject* WorldContextObject)
 {
+	if (!ItemClass)
+	{
+		return FItemId();
+	}
+
+	// Every item and every query for a class read the same default object, so they all agree on the ID. Class defaults have no world
+	// of their own, which is why the caller has to help find the catalog the first time
+	const UItem* DefaultItem = CastChecked<UItem>(ItemClass->GetDefaultObject());
+
+	if (!DefaultItem->bItemIdCached)
+	{
+		if (const UItemCatalog* Catalog = UItemCatalog::Get(WorldContextObject))
+		{
+			DefaultItem->CachedItemId = Catalog->GetItemId(ItemClass);
+			DefaultItem->bItemIdCached = true;
+		}
+	}
+
+	return DefaultItem->CachedItemId;
+}
+
+FText UItem::GetUseActionText() const
+{
+	const FText& UseActionText = GetDefinition()->UseActionText;
+	return UseActionText.IsEmpty() ? LOCTEXT("ItemUseActionText", "Use") : UseActionText;
+}
+
+bool UItem::IsStackable() const
+{
+	return GetDefinition()->bStackable;
+}
+
+void UItem::OnRep_Quantity(const int32 OldQuantity)
+{
+	if (OwningInventory)
+	{
+		OwningInventory->OnItemQuantityChanged(this, OldQuantity);
+	}
+
 	OnItemModified.Broadcast();
 }
 
@@ -54,7 +121,14 @@ void UItem::SetQuantity(const int32 NewQuantity)
 {
 	if (NewQuantity != Quantity)
 	{
-		Quantity = FMath::Clamp(NewQuantity, 0, bStackable ? MaxStackSize : 1);
+		const int32 OldQuantity = Quantity;
+		Quantity = FMath::Clamp(NewQuantity, 0, GetMaxStackSize());
+
+		if (OwningInventory)
+		{
+			OwningInventory->OnItemQuantityChanged(this, OldQuantity);
+		}
+
 		MarkDirtyForReplication();
 	}
 }
@@ -64,6 +138,11 @@ bool UItem::ShouldShowInInventory() const
 	return true;
 }
 
+bool UItem::ShouldReplicateInSummary() const
+{
+	return false;
+}
+
 
 void UItem::Use(class ASurvivalCharacter* Character)
 {
@@ -78,10 +157,133 @@ void UItem::AddedToInventory(class UInventoryComponent* Inventory)
 	// Mark the array for replication
 	if (OwningInventory)
 	{
-		++OwningInventory->ReplicatedItemsKey;
+		OwningInventory->MarkItemDirty(this);
+	}
+}
+
+void UItem::RemovedFromInventory(class UInventoryComponent* Inventory)
+{
+
+}
+
+void UItem::ChangeOuter(UObject* NewOuter)
+{
+	if (NewOuter && GetOuter() != NewOuter)
+	{
+		// Items move between owners a lot, so skip the work Rename() would do for editor and undo support
+		Rename(nullptr, NewOuter, REN_DontCreateRedirectors | REN_ForceNoResetLoaders | REN_DoNotDirty | REN_NonTransactional);
+	}
+}
+
+class UItem* UItem::MoveToOuter(UObject* NewOuter)
+{
+	if (!NewOuter || GetOuter() == NewOuter)
+	{
+		return this;
+	}
+
+	if (!HasBeenReplicated())
+	{
+		ChangeOuter(NewOuter);
+		return this;
 	}
+
+	// Quantity is all the state an item has that isn't shared with its class
+	UItem* NewItem = UItemPool::CreateItem(NewOuter, GetClass());
+	NewItem->SetQuantity(Quantity);
+	return NewItem;
 }
 
+void UItem::ResetItem()
+{
+	OwningInventory = nullptr;
+	Quantity = 1;
+	OnItemModified.Clear();
+
+	/** Don't set RepKey back to zero. Channels remember the last RepKey they sent for this object, and if it comes back into
+	the same channel with a RepKey that happens to match, it would never be sent. Bumping it makes sure it always looks changed. **/
+	++RepKey;
+}
+
+bool UItem::HasBeenReplicated() const
+{
+	const UWorld* World = GetWorld();
+
+	if (!World)
+	{
+		return false;
+	}
+
+	// An object is given a NetGUID the first time it's written to a channel, and keeps it for as long as it's alive
+	const UNetDriver* NetDrivers[] = { World->GetNetDriver(), World->GetDemoNetDriver() };
+
+	for (const UNetDriver* NetDriver : NetDrivers)
+	{
+		if (NetDriver && NetDriver->GuidCache.IsValid() && NetDriver->GuidCache->GetNetGUID(this).IsValid())
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+#if WITH_EDITORONLY_DATA
+bool UItem::NeedsItemDataMigration() const
+{
+	// The old properties were EditDefaultsOnly, so only the class defaults of item Blueprints can have saved values in them
+	if (!HasAnyFlags(RF_ClassDefaultObject) || !GetClass()->ClassGeneratedBy)
+	{
+		return false;
+	}
+
+	const UItem* ParentDefaults = Cast<UItem>(GetClass()->GetSuperClass()->GetDefaultObject());
+
+	// A definition set since the move is newer than anything in the old properties
+	if (!ParentDefaults || Definition != ParentDefaults->Definition)
+	{
+		return false;
+	}
+
+	return PickUpMesh_DEPRECATED != ParentDefaults->PickUpMesh_DEPRECATED
+		|| Thumbnail_DEPRECATED != ParentDefaults->Thumbnail_DEPRECATED
+		|| !ItemDisplayName_DEPRECATED.EqualTo(ParentDefaults->ItemDisplayName_DEPRECATED)
+		|| !ItemDescription_DEPRECATED.EqualTo(ParentDefaults->ItemDescription_DEPRECATED)
+		|| !UseActionText_DEPRECATED.EqualTo(ParentDefaults->UseActionText_DEPRECATED)
+		|| Rarity_DEPRECATED != ParentDefaults->Rarity_DEPRECATED
+		|| Weight_DEPRECATED != ParentDefaults->Weight_DEPRECATED
+		|| bStackable_DEPRECATED != ParentDefaults->bStackable_DEPRECATED
+		|| MaxStackSize_DEPRECATED != ParentDefaults->MaxStackSize_DEPRECATED
+		|| ItemTooltip_DEPRECATED != ParentDefaults->ItemTooltip_DEPRECATED;
+}
+
+void UItem::MigrateDeprecatedItemData()
+{
+	// The definition goes in the Blueprint's own package, so it's saved along with the Blueprint and nothing else has to change
+	UPackage* Package = GetOutermost();
+	const FName DefinitionName = MakeUniqueObjectName(Package, UItemDefinition::StaticClass(), *FString::Printf(TEXT("%s_Definition"), *GetClass()->ClassGeneratedBy->GetName()));
+
+	UItemDefinition* NewDefinition = NewObject<UItemDefinition>(Package, DefinitionName, RF_Public | RF_Transactional);
+	NewDefinition->PickUpMesh = PickUpMesh_DEPRECATED;
+	NewDefinition->Thumbnail = Thumbnail_DEPRECATED;
+	NewDefinition->ItemDisplayName = ItemDisplayName_DEPRECATED;
+	NewDefinition->ItemDescription = ItemDescription_DEPRECATED;
+	NewDefinition->UseActionText = UseActionText_DEPRECATED;
+	NewDefinition->Rarity = Rarity_DEPRECATED;
+	NewDefinition->Weight = Weight_DEPRECATED;
+	NewDefinition->bStackable = bStackable_DEPRECATED;
+	NewDefinition->MaxStackSize = MaxStackSize_DEPRECATED;
+	NewDefinition->ItemTooltip = ItemTooltip_DEPRECATED;
+
+	Definition = NewDefinition;
+
+	// MarkPackageDirty() does nothing while loading, so set the flag directly
+	Package->SetDirtyFlag(true);
+
+	UE_LOG(LogTemp, Warning, TEXT("Moved the item data of %s into %s. Resave %s to keep it"), *GetNameSafe(GetClass()), *NewDefinition->GetName(), *Package->GetName());
+}
+#endif
+
 void UItem::MarkDirtyForReplication()
 {
 	// Mark this object for replication
@@ -90,8 +292,155 @@ void UItem::MarkDirtyForReplication()
 	// Mark the array for replication 
 	if (OwningInventory)
 	{
-		++OwningInventory->ReplicatedItemsKey;
+		OwningInventory->MarkItemDirty(this);
 	}
 }
 
+#if !UE_BUILD_SHIPPING
+static FAutoConsoleCommand ItemMemReportCommand(
+	TEXT("SurvivalGame.Items.MemReport"),
+	TEXT("Logs how many items are alive, how much memory their instances take and how many item definitions they share."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		int32 NumItems = 0;
+		SIZE_T InstanceBytes = 0;
+		TSet<const UItemDefinition*> Definitions;
+
+		for (TObjectIterator<UItem> It; It; ++It)
+		{
+			if (!It->HasAnyFlags(RF_ClassDefaultObject | RF_ArchetypeObject))
+			{
+				NumItems++;
+				InstanceBytes += It->GetClass()->GetStructureSize();
+				Definitions.Add(It->GetDefinition());
+			}
+		}
+
+		UE_LOG(LogTemp, Log, TEXT("%d live items, %llu bytes of item instances (%.1f bytes per item), sharing %d item definitions"),
+			NumItems, (uint64)InstanceBytes, NumItems > 0 ? (float)InstanceBytes / NumItems : 0.f, Definitions.Num());
+	}));
+
+static FAutoConsoleCommandWithArgs ItemMemCompareCommand(
+	TEXT("SurvivalGame.Items.MemCompare"),
+	TEXT("Creates a number of items, 10000 by default, and logs what they take now compared to items carrying their own static data. Usage: SurvivalGame.Items.MemCompare [count]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const int32 Count = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 10000;
+
+		// Deprecated properties are editor only, so leave them out to get the size items have in a cooked game
+		SIZE_T DeprecatedBytes = 0;
+
+		for (TFieldIterator<FProperty> It(UItem::StaticClass()); It; ++It)
+		{
+			DeprecatedBytes += It->HasAnyPropertyFlags(CPF_Deprecated) ? It->GetSize() : 0;
+		}
+
+		// Before the move every item carried all of its definition's data, and a full multicast delegate rather than a sparse one
+		const SIZE_T InstanceBytes = UItem::StaticClass()->GetStructureSize() - DeprecatedBytes;
+		const SIZE_T DefinitionBytes = UItemDefinition::StaticClass()->GetStructureSize() - UPrimaryDataAsset::StaticClass()->GetStructureSize();
+		const SIZE_T LegacyBytes = InstanceBytes + DefinitionBytes + sizeof(FMulticastScriptDelegate) - sizeof(FOnItemModified);
+
+		const double StartSeconds = FPlatformTime::Seconds();
+		const uint64 StartMemory = FPlatformMemory::GetStats().UsedPhysical;
+
+		TArray<UItem*> Items;
+		Items.Reserve(Count);
+
+		for (int32 i = 0; i < Count; ++i)
+		{
+			Items.Add(NewObject<UItem>(GetTransientPackage()));
+		}
+
+		const double CreateSeconds = FPlatformTime::Seconds() - StartSeconds;
+		const int64 MeasuredBytes = (int64)FPlatformMemory::GetStats().UsedPhysical - (int64)StartMemory;
+
+		for (UItem* Item : Items)
+		{
+			Item->MarkPendingKill();
+		}
+
+		UE_LOG(LogTemp, Log, TEXT("%d items: %llu bytes each, %.2f MB in total. With their static data on every instance: %llu bytes each, %.2f MB in total"),
+			Count, (uint64)InstanceBytes, (double)(InstanceBytes * Count) / (1024.0 * 1024.0), (uint64)LegacyBytes, (double)(LegacyBytes * Count) / (1024.0 * 1024.0));
+		UE_LOG(LogTemp, Log, TEXT("Creating them took %.2f ms and the process grew by %.2f MB, which includes object overhead and allocator slack"),
+			CreateSeconds * 1000.0, (double)MeasuredBytes / (1024.0 * 1024.0));
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs InventoryBulkAddBenchCommand(
+	TEXT("SurvivalGame.Items.BenchBulkAdd"),
+	TEXT("Times TryAddItemsFromClass() against the same items added with a loop of TryAddItemFromClass(). Usage: SurvivalGame.Items.BenchBulkAdd [NumEntries=20] [Iterations=1000]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (!World || World->IsNetMode(NM_Client))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("SurvivalGame.Items.BenchBulkAdd has to run on the server or in standalone."));
+			return;
+		}
+
+		const int32 NumEntries = FMath::Clamp(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 20, 1, 200);
+		const int32 Iterations = FMath::Max(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1000, 1);
+
+		// Build a loot crate out of every concrete item class that is loaded
+		TArray<UClass*> ItemClasses;
+
+		for (TObjectIterator<UClass> It; It; ++It)
+		{
+			if (It->IsChildOf(UItem::StaticClass()) && !It->HasAnyClassFlags(CLASS_Abstract | CLASS_Deprecated | CLASS_NewerVersionExists)
+				&& !It->GetName().StartsWith(TEXT("SKEL_")) && !It->GetName().StartsWith(TEXT("REINST_")))
+			{
+				ItemClasses.Add(*It);
+			}
+		}
+
+		TArray<FItemClassQuantity> Crate;
+
+		for (int32 i = 0; i < NumEntries; ++i)
+		{
+			Crate.Emplace(ItemClasses[i % ItemClasses.Num()], 1 + i % 3);
+		}
+
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.ObjectFlags |= RF_Transient;
+
+		AActor* InventoryOwner = World->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParams);
+		UInventoryComponent* Inventory = NewObject<UInventoryComponent>(InventoryOwner);
+		Inventory->RegisterComponent();
+		Inventory->SetCapacity(NumEntries);
+		Inventory->SetWeightCapacity(BIG_NUMBER);
+
+		double LoopSeconds = 0.0;
+		double BulkSeconds = 0.0;
+
+		{
+			// TryAddItemsFromClass() flushes notifications when its own batch ends, while single adds leave them for the next tick.
+			// Holding one batch open across the whole run keeps every flush, including the one the capacity changes above asked for, out
+			// of both timings, so only the add paths are compared
+			FInventoryBatchScope Batch(Inventory);
+
+			for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+			{
+				double StartSeconds = FPlatformTime::Seconds();
+
+				for (const FItemClassQuantity& Entry : Crate)
+				{
+					Inventory->TryAddItemFromClass(Entry.ItemClass, Entry.Quantity);
+				}
+
+				LoopSeconds += FPlatformTime::Seconds() - StartSeconds;
+				Inventory->RemoveItems(Inventory->GetItems());
+
+				StartSeconds = FPlatformTime::Seconds();
+				Inventory->TryAddItemsFromClass(Crate, false);
+				BulkSeconds += FPlatformTime::Seconds() - StartSeconds;
+
+				Inventory->RemoveItems(Inventory->GetItems());
+			}
+		}
+
+		UE_LOG(LogTemp, Log, TEXT("Adding %d entries from %d item classes, %d times: single calls %.2fus, bulk %.2fus per batch (%.2fx)"),
+			NumEntries, ItemClasses.Num(), Iterations, LoopSeconds * 1000000.0 / Iterations, BulkSeconds * 1000000.0 / Iterations, BulkSeconds > 0.0 ? LoopSeconds / BulkSeconds : 0.0);
+
+		InventoryOwner->Destroy();
+	}));
+#endif
+
 #undef  LOCTEXT_NAMESPACE
\ No newline at end of file
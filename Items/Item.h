@@ -5,19 +5,12 @@
 #include "CoreMinimal.h"
 #include "Delegates/Delegate.h"
 #include "UObject/NoExportTypes.h"
+#include "Items/ItemDefinition.h"
+#include "Items/ItemId.h"
 #include "Item.generated.h"
 
-DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnItemModified);
-
-UENUM(BlueprintType)
-enum class EItemRarity : uint8
-{
-	IR_Common UMETA(DisplayName = "Common"),
-	IR_Uncommon UMETA(DisplayName = "Uncommon"),
-	IR_Rare UMETA(DisplayName = "Rare"),
-	IR_VeryRare UMETA(DisplayName = "Very Rare"),
-	IR_Legendary UMETA(DisplayName = "Legendary")
-};
+// Sparse, so items nobody is listening to don't pay for an empty invocation list
+DECLARE_DYNAMIC_MULTICAST_SPARSE_DELEGATE(FOnItemModified, UItem, OnItemModified);
 
 /**
  * 
@@ -35,51 +28,51 @@ protected:
 	virtual void PostEditChangeProperty(struct FPropertyChangedEvent& PropertyChangedEvent) override;
 #endif
 
+	virtual void PostLoad() override;
+
 public:
 	UItem();
 
-	/** The mesh to display for this item pickup **/
-	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item")
-	UStaticMesh *PickUpMesh;
-
-	/** The thumbnail for this item **/
+	/** The static data for this item. Set this in the class defaults, every instance shares it **/
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Item")
-	class UTexture2D *Thumbnail;
+	UItemDefinition* Definition;
+
+#if WITH_EDITORONLY_DATA
+	// The static data items used to carry themselves, before it moved to UItemDefinition. Only kept so item Blueprints saved before
+	// then still load their values, which PostLoad() copies into a definition. Read them through the Get functions below instead
+	UPROPERTY(meta = (DeprecatedProperty, DeprecationMessage = "Moved to the item's Definition"))
+	UStaticMesh* PickUpMesh_DEPRECATED;
 
-	/** The display name for this item in the inventory **/
-	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item")
-	FText ItemDisplayName;
+	UPROPERTY(meta = (DeprecatedProperty, DeprecationMessage = "Moved to the item's Definition"))
+	class UTexture2D* Thumbnail_DEPRECATED;
 
-	/** An optional description for the item **/
-	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item", meta = (MultiLine = true))
-	FText ItemDescription;
+	UPROPERTY(meta = (DeprecatedProperty, DeprecationMessage = "Moved to the item's Definition"))
+	FText ItemDisplayName_DEPRECATED;
 
-	/** The text for using the item (Equip, Eat, etc) **/
-	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item")
-	FText UseActionText;
+	UPROPERTY(meta = (DeprecatedProperty, DeprecationMessage = "Moved to the item's Definition"))
+	FText ItemDescription_DEPRECATED;
 
-	/** The rarity of the item **/
-	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item")
-	EItemRarity Rarity;
+	UPROPERTY(meta = (DeprecatedProperty, DeprecationMessage = "Moved to the item's Definition"))
+	FText UseActionText_DEPRECATED;
 
-	/** The weight of the item **/
-	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item", meta = (ClampMin = 0.0))
-	float Weight;
+	UPROPERTY(meta = (DeprecatedProperty, DeprecationMessage = "Moved to the item's Definition"))
+	EItemRarity Rarity_DEPRECATED;
 
-	/** Whether or not this item can be stacked **/
-	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item")
-	bool bStackable;
+	UPROPERTY(meta = (DeprecatedProperty, DeprecationMessage = "Moved to the item's Definition"))
+	float Weight_DEPRECATED;
 
-	/** The maximum size that a stack of items can be **/
-	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item", meta = (ClampMin = 0.0, EditCondition = bStackable))
-	int32 MaxStackSize;
+	UPROPERTY(meta = (DeprecatedProperty, DeprecationMessage = "Moved to the item's Definition"))
+	bool bStackable_DEPRECATED;
 
-	/** The tooltip in the inventory for this item **/
-	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item")
-	TSubclassOf<class UItemTooltip> ItemTooltip;
+	UPROPERTY(meta = (DeprecatedProperty, DeprecationMessage = "Moved to the item's Definition"))
+	int32 MaxStackSize_DEPRECATED;
+
+	UPROPERTY(meta = (DeprecatedProperty, DeprecationMessage = "Moved to the item's Definition"))
+	TSubclassOf<class UItemTooltip> ItemTooltip_DEPRECATED;
+#endif
 
 	/** The amount of the item **/
-	UPROPERTY(ReplicatedUsing = OnRep_Quantity, EditAnywhere, Category = "Item", meta = (UIMin = 1, EditCondition = bStackable))
+	UPROPERTY(ReplicatedUsing = OnRep_Quantity, EditAnywhere, Category = "Item", meta = (UIMin = 1))
 	int32 Quantity;
 
 	/** The inventory that owns this item **/
@@ -94,7 +87,7 @@ public:
 	FOnItemModified OnItemModified;
 
 	UFUNCTION()
-	void OnRep_Quantity();
+	void OnRep_Quantity(const int32 OldQuantity);
 
 	UFUNCTION(BlueprintCallable, Category = "Item")
 	void SetQuantity(const int32 NewQuantity);
@@ -103,15 +96,93 @@ public:
 	FORCEINLINE int32 GetQuantity() const { return Quantity; };
 
 	UFUNCTION(BlueprintCallable, Category = "Item")
-	FORCEINLINE float GetStackWeight() const {return Quantity * Weight; };
+	FORCEINLINE float GetStackWeight() const {return Quantity * GetWeight(); };
+
+	/** The catalog ID of this item's class. Invalid if there's no catalog, or the class hasn't been added to it **/
+	FORCEINLINE FItemId GetItemId() const { return GetItemIdOfClass(GetClass(), this); };
+
+	/** The catalog ID of an item class. The ID is cached on the class default object, so only the first call for each class goes
+	to the catalog, which WorldContextObject is used to find **/
+	static FItemId GetItemIdOfClass(const UClass* ItemClass, const UObject* WorldContextObject);
+
+	// Accessors for the static item data. These are never null, items without a definition fall back to the UItemDefinition defaults.
+	FORCEINLINE const UItemDefinition* GetDefinition() const { return Definition ? Definition : GetDefault<UItemDefinition>(); };
+
+	UFUNCTION(BlueprintPure, Category = "Item")
+	FORCEINLINE UStaticMesh* GetPickUpMesh() const { return GetDefinition()->PickUpMesh; };
+
+	UFUNCTION(BlueprintPure, Category = "Item")
+	FORCEINLINE class UTexture2D* GetThumbnail() const { return GetDefinition()->Thumbnail; };
+
+	UFUNCTION(BlueprintPure, Category = "Item")
+	FORCEINLINE FText GetDisplayName() const { return GetDefinition()->ItemDisplayName; };
+
+	UFUNCTION(BlueprintPure, Category = "Item")
+	FORCEINLINE FText GetDescription() const { return GetDefinition()->ItemDescription; };
+
+	UFUNCTION(BlueprintPure, Category = "Item")
+	virtual FText GetUseActionText() const;
+
+	UFUNCTION(BlueprintPure, Category = "Item")
+	FORCEINLINE EItemRarity GetRarity() const { return GetDefinition()->Rarity; };
+
+	UFUNCTION(BlueprintPure, Category = "Item")
+	FORCEINLINE float GetWeight() const { return GetDefinition()->Weight; };
+
+	UFUNCTION(BlueprintPure, Category = "Item")
+	virtual bool IsStackable() const;
+
+	UFUNCTION(BlueprintPure, Category = "Item")
+	FORCEINLINE int32 GetMaxStackSize() const { return IsStackable() ? GetDefinition()->MaxStackSize : 1; };
+
+	UFUNCTION(BlueprintPure, Category = "Item")
+	FORCEINLINE TSubclassOf<class UItemTooltip> GetTooltipClass() const { return GetDefinition()->ItemTooltip; };
 
 
 	UFUNCTION(BlueprintPure, Category = "Item")
 	virtual bool ShouldShowInInventory() const;
 
+	/** Whether clients that can't see the whole inventory should still get this item, ie because it is visible on the character **/
+	virtual bool ShouldReplicateInSummary() const;
+
 	virtual void Use(class ASurvivalCharacter *Character);
 	virtual void AddedToInventory(class UInventoryComponent* Inventory);
+	virtual void RemovedFromInventory(class UInventoryComponent* Inventory);
+
+	/** Move the item to a new outer when it changes owner, ie when it moves from a pickup to an inventory. Much cheaper than creating a new item.
+	Only for items that have never been replicated, use MoveToOuter() when that isn't known **/
+	void ChangeOuter(UObject* NewOuter);
+
+	/** Hand the item over to a new owner. Items that have never been replicated are moved with ChangeOuter(). Replicated ones stay
+	where they are, since clients got them through their old owner's channel and lose them when it closes, and a fresh item with the
+	same class and quantity is created under NewOuter instead. Returns whichever item NewOuter now owns **/
+	class UItem* MoveToOuter(UObject* NewOuter);
+
+	/** Put the item back into its freshly created state so UItemPool can hand it out again **/
+	virtual void ResetItem();
+
+	/** Whether the item has been sent to any client, as a subobject or just a reference. Clients know such an item by its NetGUID
+	and through the channel of the actor it was sent with, so it must never be handed to another actor or reused as a different item **/
+	bool HasBeenReplicated() const;
 
 	/** Mark the object as needing replication. We must call this internally after modifying any replicated properties **/
 	void MarkDirtyForReplication();
+
+private:
+
+	friend class UItemCatalog;
+
+	// Only used on the class default object. Filled in by GetItemIdOfClass() the first time the class is asked for, and reset by the
+	// catalog when it hands out new IDs
+	mutable FItemId CachedItemId;
+	mutable bool bItemIdCached;
+
+#if WITH_EDITORONLY_DATA
+	// Whether this is the class default object of an item Blueprint that was saved with its own values in the deprecated properties,
+	// and still uses its parent's definition
+	bool NeedsItemDataMigration() const;
+
+	// Copy the deprecated properties into a new definition saved in the Blueprint's package
+	void MigrateDeprecatedItemData();
+#endif
 };
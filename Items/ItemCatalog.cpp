@@ -0,0 +1,166 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Items/ItemCatalog.h"
+#include "Items/Item.h"
+#include "Framework/SurvivalGameInstance.h"
+#include "Engine/World.h"
+#include "UObject/UObjectIterator.h"
+
+#if WITH_EDITOR
+#include "AssetRegistryModule.h"
+#include "Engine/Blueprint.h"
+#include "Misc/PackageName.h"
+#endif
+
+UItemCatalog* UItemCatalog::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+
+	if (USurvivalGameInstance* GameInstance = World ? World->GetGameInstance<USurvivalGameInstance>() : nullptr)
+	{
+		return GameInstance->GetItemCatalog();
+	}
+
+	return nullptr;
+}
+
+FItemId UItemCatalog::GetItemId(const UClass* ItemClass) const
+{
+	if (ItemClass)
+	{
+		if (const FItemId* ItemId = IdByPath.Find(FSoftObjectPath(ItemClass)))
+		{
+			return *ItemId;
+		}
+	}
+
+	return FItemId();
+}
+
+TSubclassOf<class UItem> UItemCatalog::GetItemClass(const FItemId ItemId) const
+{
+	const int32 Index = (int32)ItemId.GetValue() - 1;
+
+	if (!ItemClasses.IsValidIndex(Index) || ItemClasses[Index].IsNull())
+	{
+		return nullptr;
+	}
+
+	// Usually already loaded by whatever handed out the ID. Spawning loot from a table may be the first time a class is needed
+	UClass* ItemClass = ItemClasses[Index].Get();
+	return ItemClass ? ItemClass : ItemClasses[Index].LoadSynchronous();
+}
+
+const class UItemDefinition* UItemCatalog::GetItemDefinition(const FItemId ItemId) const
+{
+	TSubclassOf<UItem> ItemClass = GetItemClass(ItemId);
+	return ItemClass ? ItemClass->GetDefaultObject<UItem>()->GetDefinition() : nullptr;
+}
+
+void UItemCatalog::PostLoad()
+{
+	Super::PostLoad();
+
+	BuildLookup();
+}
+
+void UItemCatalog::BuildLookup()
+{
+	IdByPath.Reset();
+	IdByPath.Reserve(ItemClasses.Num());
+
+	for (int32 i = 0; i < ItemClasses.Num(); ++i)
+	{
+		if (!ItemClasses[i].IsNull())
+		{
+			IdByPath.Add(ItemClasses[i].ToSoftObjectPath(), FItemId((uint16)(i + 1)));
+		}
+	}
+}
+
+#if WITH_EDITOR
+void UItemCatalog::RebuildCatalog()
+{
+	TArray<UClass*> FoundClasses;
+
+	auto IsCatalogClass = [](const UClass* Class)
+	{
+		return Class && Class->IsChildOf(UItem::StaticClass()) && !Class->HasAnyClassFlags(CLASS_Abstract | CLASS_Deprecated | CLASS_NewerVersionExists)
+			&& !Class->GetName().StartsWith(TEXT("SKEL_")) && !Class->GetName().StartsWith(TEXT("REINST_"));
+	};
+
+	// Native item classes are always loaded
+	for (TObjectIterator<UClass> It; It; ++It)
+	{
+		if (It->HasAnyClassFlags(CLASS_Native) && IsCatalogClass(*It))
+		{
+			FoundClasses.Add(*It);
+		}
+	}
+
+	// Blueprint item classes might not be, so find them through the asset registry and only load the ones that are items
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>(TEXT("AssetRegistry")).Get();
+
+	TSet<FName> DerivedClassNames;
+	AssetRegistry.GetDerivedClassNames({ UItem::StaticClass()->GetFName() }, TSet<FName>(), DerivedClassNames);
+
+	TArray<FAssetData> BlueprintAssets;
+	AssetRegistry.GetAssetsByClass(UBlueprint::StaticClass()->GetFName(), BlueprintAssets, true);
+
+	for (const FAssetData& BlueprintAsset : BlueprintAssets)
+	{
+		FString GeneratedClassPath;
+
+		if (BlueprintAsset.GetTagValue(FBlueprintTags::GeneratedClassPath, GeneratedClassPath))
+		{
+			const FString ClassObjectPath = FPackageName::ExportTextPathToObjectPath(GeneratedClassPath);
+
+			if (DerivedClassNames.Contains(FName(*FPackageName::ObjectPathToObjectName(ClassObjectPath))))
+			{
+				UClass* Class = LoadObject<UClass>(nullptr, *ClassObjectPath);
+
+				if (IsCatalogClass(Class))
+				{
+					FoundClasses.AddUnique(Class);
+				}
+			}
+		}
+	}
+
+	// Sort new classes by path so rebuilding on two machines hands out the same IDs
+	FoundClasses.Sort([](const UClass& A, const UClass& B) { return A.GetPathName() < B.GetPathName(); });
+
+	Modify();
+
+	int32 NumAdded = 0;
+
+	for (UClass* Class : FoundClasses)
+	{
+		if (!IdByPath.Contains(FSoftObjectPath(Class)))
+		{
+			if (!ensureMsgf(ItemClasses.Num() < MAX_uint16, TEXT("%s is full, %s can't be given an ID"), *GetName(), *Class->GetName()))
+			{
+				break;
+			}
+
+			ItemClasses.Add(Class);
+			IdByPath.Add(FSoftObjectPath(Class), FItemId((uint16)ItemClasses.Num()));
+			++NumAdded;
+		}
+	}
+
+	// Classes that were asked for before they had an ID cached that they had none
+	for (UClass* Class : FoundClasses)
+	{
+		Class->GetDefaultObject<UItem>()->bItemIdCached = false;
+	}
+
+	// Every item class that still exists was loaded above, so whatever doesn't resolve now has been deleted
+	const int32 NumEmpty = ItemClasses.Num() - ItemClasses.FilterByPredicate([](const TSoftClassPtr<UItem>& Class) { return Class.Get() != nullptr; }).Num();
+
+	UE_LOG(LogTemp, Log, TEXT("%s: added %d item classes, %d in total, %d empty slots left by deleted classes"), *GetName(), NumAdded, ItemClasses.Num(), NumEmpty);
+
+	BuildLookup();
+}
+#endif
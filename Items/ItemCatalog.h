@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "Items/ItemId.h"
+#include "ItemCatalog.generated.h"
+
+/**
+ * Every item class in the game, each with a stable FItemId. The ID of a class is its position in ItemClasses plus one,
+ * so looking up the class for an ID is just an array access. The list is only ever appended to, so IDs that have been
+ * saved to disk or written into loot tables keep pointing at the same item. Rebuild it in the editor after adding items.
+ * The classes are soft references, so loading the catalog doesn't load every item in the game with it. A class is loaded the
+ * first time its ID is turned back into a class, if nothing had loaded it already. The game instance holds the catalog, so it
+ * and every item it lists are still cooked.
+ * Going from a class to its ID is cached on the class default object, see UItem::GetItemIdOfClass().
+ */
+UCLASS(BlueprintType)
+class SURVIVALGAME_API UItemCatalog : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+
+	/** The catalog set on the game instance, or null if there isn't one */
+	static UItemCatalog* Get(const UObject* WorldContextObject);
+
+	/** Return the ID of an item class, or an invalid ID if it isn't in the catalog. Hashes the class's path, so use
+	UItem::GetItemIdOfClass() instead, which only calls this once per class */
+	FItemId GetItemId(const UClass* ItemClass) const;
+
+	/** Return the item class with the given ID, loading it if it isn't loaded yet, or null if there isn't one */
+	TSubclassOf<class UItem> GetItemClass(const FItemId ItemId) const;
+
+	/** Return the definition of the item class with the given ID, or null if there isn't one */
+	const class UItemDefinition* GetItemDefinition(const FItemId ItemId) const;
+
+	FORCEINLINE int32 GetNumItemIds() const { return ItemClasses.Num(); };
+
+	virtual void PostLoad() override;
+
+#if WITH_EDITOR
+	/** Add every item class that isn't in the catalog yet. Existing IDs are never changed */
+	UFUNCTION(CallInEditor, Category = "Item Catalog")
+	void RebuildCatalog();
+#endif
+
+protected:
+
+	// Index + 1 is the ID of each class. Classes that have been deleted leave their slot behind, so later IDs don't move
+	UPROPERTY(VisibleAnywhere, Category = "Item Catalog")
+	TArray<TSoftClassPtr<class UItem>> ItemClasses;
+
+private:
+
+	// The reverse of ItemClasses. Keyed by path rather than class, so it works for classes that aren't loaded yet, and for Blueprint
+	// classes that have been recompiled, which replaces the class but keeps its path
+	TMap<FSoftObjectPath, FItemId> IdByPath;
+
+	void BuildLookup();
+};
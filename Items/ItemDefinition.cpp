@@ -0,0 +1,17 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Items/ItemDefinition.h"
+
+#define LOCTEXT_NAMESPACE "ItemDefinition"
+
+UItemDefinition::UItemDefinition()
+{
+	ItemDisplayName = LOCTEXT("ItemName", "Item");
+	Rarity = EItemRarity::IR_Common;
+	Weight = 0.f;
+	bStackable = true;
+	MaxStackSize = 2;
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "ItemDefinition.generated.h"
+
+UENUM(BlueprintType)
+enum class EItemRarity : uint8
+{
+	IR_Common UMETA(DisplayName = "Common"),
+	IR_Uncommon UMETA(DisplayName = "Uncommon"),
+	IR_Rare UMETA(DisplayName = "Rare"),
+	IR_VeryRare UMETA(DisplayName = "Very Rare"),
+	IR_Legendary UMETA(DisplayName = "Legendary")
+};
+
+/**
+ * The static data of an item, shared by every instance of it. Item classes point at one of these from their class defaults,
+ * so a UItem instance only has to carry the state that actually changes, like its quantity.
+ */
+UCLASS(BlueprintType)
+class SURVIVALGAME_API UItemDefinition : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+
+	UItemDefinition();
+
+	/** The mesh to display for this item pickup **/
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Item")
+	class UStaticMesh* PickUpMesh;
+
+	/** The thumbnail for this item **/
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Item")
+	class UTexture2D* Thumbnail;
+
+	/** The display name for this item in the inventory **/
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Item")
+	FText ItemDisplayName;
+
+	/** An optional description for the item **/
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Item", meta = (MultiLine = true))
+	FText ItemDescription;
+
+	/** The text for using the item (Equip, Eat, etc). Leave empty to use the default for the item class **/
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Item")
+	FText UseActionText;
+
+	/** The rarity of the item **/
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Item")
+	EItemRarity Rarity;
+
+	/** The weight of the item **/
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Item", meta = (ClampMin = 0.0))
+	float Weight;
+
+	/** Whether or not this item can be stacked **/
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Item")
+	bool bStackable;
+
+	/** The maximum size that a stack of items can be **/
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Item", meta = (ClampMin = 0.0, EditCondition = bStackable))
+	int32 MaxStackSize;
+
+	/** The tooltip in the inventory for this item **/
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Item")
+	TSubclassOf<class UItemTooltip> ItemTooltip;
+};
@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ItemId.generated.h"
+
+/**
+ * A compact, stable identifier for an item class, handed out by UItemCatalog. Two bytes on the wire and in save files,
+ * and hashing it is just the number, unlike a class pointer or soft class path. Zero means no item.
+ */
+USTRUCT(BlueprintType)
+struct SURVIVALGAME_API FItemId
+{
+	GENERATED_BODY()
+
+public:
+
+	FItemId() : Value(0) {};
+	explicit FItemId(const uint16 InValue) : Value(InValue) {};
+
+	FORCEINLINE bool IsValid() const { return Value != 0; };
+	FORCEINLINE uint16 GetValue() const { return Value; };
+
+	FORCEINLINE bool operator==(const FItemId& Other) const { return Value == Other.Value; };
+	FORCEINLINE bool operator!=(const FItemId& Other) const { return Value != Other.Value; };
+
+	friend FORCEINLINE uint32 GetTypeHash(const FItemId& ItemId) { return ItemId.Value; };
+
+	friend FArchive& operator<<(FArchive& Ar, FItemId& ItemId)
+	{
+		Ar << ItemId.Value;
+		return Ar;
+	}
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess)
+	{
+		Ar << Value;
+		bOutSuccess = true;
+		return true;
+	}
+
+	FString ToString() const { return FString::Printf(TEXT("%u"), Value); };
+
+private:
+
+	UPROPERTY(VisibleAnywhere, SaveGame, Category = "Item Id")
+	uint16 Value;
+};
+
+template<>
+struct TStructOpsTypeTraits<FItemId> : public TStructOpsTypeTraitsBase2<FItemId>
+{
+	enum
+	{
+		WithNetSerializer = true,
+		WithIdenticalViaEquality = true,
+	};
+};
@@ -0,0 +1,117 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Items/ItemPool.h"
+#include "Items/Item.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+UItemPool::UItemPool()
+{
+	MaxPooledItemsPerClass = 64;
+	NumHits = 0;
+	NumMisses = 0;
+	NumReleased = 0;
+	NumDiscarded = 0;
+	NumReplicatedSkipped = 0;
+}
+
+UItemPool* UItemPool::Get(const UObject* WorldContextObject)
+{
+	if (UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr)
+	{
+		return World->GetSubsystem<UItemPool>();
+	}
+	return nullptr;
+}
+
+UItem* UItemPool::CreateItem(UObject* Outer, TSubclassOf<class UItem> ItemClass)
+{
+	if (UItemPool* Pool = Get(Outer))
+	{
+		return Pool->AcquireItem(Outer, ItemClass);
+	}
+
+	return NewObject<UItem>(Outer, ItemClass);
+}
+
+void UItemPool::DestroyItem(class UItem* Item)
+{
+	if (UItemPool* Pool = Get(Item))
+	{
+		Pool->ReleaseItem(Item);
+	}
+}
+
+UItem* UItemPool::AcquireItem(UObject* Outer, TSubclassOf<class UItem> ItemClass)
+{
+	if (!Outer || !ItemClass)
+	{
+		return nullptr;
+	}
+
+	if (FItemPoolBucket* Bucket = PooledItems.Find(ItemClass))
+	{
+		while (Bucket->Items.Num() > 0)
+		{
+			UItem* Item = Bucket->Items.Pop(false);
+
+			if (IsValid(Item))
+			{
+				Item->ChangeOuter(Outer);
+				++NumHits;
+				return Item;
+			}
+		}
+	}
+
+	++NumMisses;
+	return NewObject<UItem>(Outer, ItemClass);
+}
+
+void UItemPool::ReleaseItem(class UItem* Item)
+{
+	if (!IsValid(Item) || Item->HasAnyFlags(RF_ClassDefaultObject | RF_ArchetypeObject) || Item->GetOuter() == this)
+	{
+		return;
+	}
+
+	// Leave the item exactly as it is. Whoever released it may still be holding it, and clients may still be showing it
+	if (Item->HasBeenReplicated())
+	{
+		++NumReplicatedSkipped;
+		return;
+	}
+
+	Item->ResetItem();
+
+	FItemPoolBucket& Bucket = PooledItems.FindOrAdd(Item->GetClass());
+
+	++NumReleased;
+
+	if (Bucket.Items.Num() >= MaxPooledItemsPerClass)
+	{
+		++NumDiscarded;
+		return;
+	}
+
+	// Move the item out of its old owner, otherwise it would keep the owner alive after it is destroyed
+	Item->ChangeOuter(this);
+	Bucket.Items.Add(Item);
+}
+
+#if !UE_BUILD_SHIPPING
+static FAutoConsoleCommandWithWorld ItemPoolStatsCommand(
+	TEXT("SurvivalGame.Items.PoolStats"),
+	TEXT("Logs the item pool hits, misses and releases for the current world."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UItemPool* Pool = World ? World->GetSubsystem<UItemPool>() : nullptr)
+		{
+			const int32 NumRequests = Pool->NumHits + Pool->NumMisses;
+
+			UE_LOG(LogTemp, Log, TEXT("Item pool: %d hits, %d misses (%.1f%% hit rate), %d released, %d discarded because the pool was full, %d left for GC because they had been replicated"),
+				Pool->NumHits, Pool->NumMisses, NumRequests > 0 ? 100.f * Pool->NumHits / NumRequests : 0.f, Pool->NumReleased, Pool->NumDiscarded, Pool->NumReplicatedSkipped);
+		}
+	}));
+#endif
@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ItemPool.generated.h"
+
+// The pooled items of a single class
+USTRUCT()
+struct FItemPoolBucket
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<class UItem*> Items;
+};
+
+/**
+ * Recycles item objects so adding, dropping and picking up items doesn't create a new UItem every time and leave the old one for GC.
+ * Only used by the server, clients create their items through replication. Only items that were never sent to a client are recycled.
+ * Clients know a replicated item by its NetGUID and the channel it came with, so reusing one for another actor would give them a stale object.
+ *
+ * In practice the items that come back to the pool are:
+ *  - the temporary item UInventoryComponent::TryAddItemFromClass() builds and copies into the inventory
+ *  - a pickup's item when the pickup is reinitialized, returned to the pickup pool or destroyed before anybody was near enough to get it
+ *  - a dropped stack that was merged into nearby drops as a whole, if it was never replicated
+ * Items removed from an inventory are never pooled by the inventory itself (see UInventoryComponent::RemoveItem()), and an item that
+ * has been in a replicated inventory is skipped by ReleaseItem(), so in normal play inventory items are left for GC.
+ */
+UCLASS(Config = Game)
+class SURVIVALGAME_API UItemPool : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	UItemPool();
+
+	/** Get the item pool for the world the given object is in */
+	static UItemPool* Get(const UObject* WorldContextObject);
+
+	/** Create an item of ItemClass outered to Outer, reusing a pooled item if the world has one */
+	static class UItem* CreateItem(UObject* Outer, TSubclassOf<class UItem> ItemClass);
+
+	/** Give an item back to its world's pool. Only call this once nothing else will use the item. Items that have been replicated
+	are left alone for GC instead */
+	static void DestroyItem(class UItem* Item);
+
+	class UItem* AcquireItem(UObject* Outer, TSubclassOf<class UItem> ItemClass);
+	void ReleaseItem(class UItem* Item);
+
+	// The most items of any one class we'll hold on to. Items released past this are left for GC
+	UPROPERTY(Config)
+	int32 MaxPooledItemsPerClass;
+
+	// How many items were reused from the pool, and how many had to be created because the pool was empty
+	int32 NumHits;
+	int32 NumMisses;
+
+	// How many items were given back to the pool, and how many of those were dropped because the pool was full
+	int32 NumReleased;
+	int32 NumDiscarded;
+
+	// How many released items were left for GC because they had been replicated
+	int32 NumReplicatedSkipped;
+
+protected:
+
+	UPROPERTY()
+	TMap<UClass*, FItemPoolBucket> PooledItems;
+};
@@ -3,13 +3,21 @@
 
 #include "SurvivalCharacter.h"
 #include "World/Pickup.h"
+#include "World/PickupPoolSubsystem.h"
 #include "Components/InteractionComponent.h"
 #include "Components/CapsuleComponent.h"
 #include "Camera/CameraComponent.h"
 #include "Items/GearItem.h"
+#include "Items/ItemPool.h"
 #include "Materials/MaterialInstance.h"
 #include "Components/InventoryComponent.h"
 #include "GameFramework/CharacterMovementComponent.h"
+#include "SurvivalGame.h"
+#include "World/InteractionSubsystem.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Validate Interact"), STAT_ValidateInteract, STATGROUP_Game);
 
 // Sets default values
 ASurvivalCharacter::ASurvivalCharacter()
@@ -43,12 +51,34 @@ ASurvivalCharacter::ASurvivalCharacter()
 	PlayerInventory->SetCapacity(20);
 	PlayerInventory->SetWeightCapacity(80.f);
 
+	// Other players only need to know about the gear we have equipped
+	PlayerInventory->SetReplicationPolicy(EInventoryReplicationPolicy::IRP_OwnerOnly, true);
+
 	GetMesh()->SetOwnerNoSee(true);
 
 	GetCharacterMovement()->NavAgentProps.bCanCrouch = true;
 
 	InteractionCheckFrequency = 0.f;
 	InteractionCheckDistance = 1000.f;
+	// Only switch to COLLISION_INTERACTABLE once the project has the channel set up, see SurvivalGame.h
+	InteractionTraceChannel = ECC_Visibility;
+	bUseAsyncInteractionTrace = true;
+	bUseInteractionRegistry = false;
+	InteractionViewConeAngle = 10.f;
+
+	ServerInteractConeAngle = 60.f;
+	ServerInteractDistanceTolerance = 50.f;
+
+	bAdaptiveInteractionCheck = true;
+	InteractionCheckMinViewMove = 2.f;
+	InteractionCheckMinViewTurn = 0.5f;
+	InteractionCheckIdleFrequency = 0.25f;
+	InteractionCheckMovingFrequency = 0.05f;
+	InteractionCheckFastFrequency = 0.f;
+	InteractionCheckFastTurnRate = 90.f;
+	InteractionCheckFastMoveSpeed = 600.f;
+
+	InteractionTraceDelegate.BindUObject(this, &ASurvivalCharacter::OnInteractionTraceCompleted);
 
 }
 
@@ -122,12 +152,16 @@ void ASurvivalCharacter::DropItem(class UItem* Item, int32 Quantity)
 		if (HasAuthority())
 		{
 			const int32 ItemQuantity = Item->GetQuantity();
-			const int32 DroppedQuantity = PlayerInventory->ConsumeItem(Item, Quantity);
+			const bool bDropWholeStack = Quantity >= ItemQuantity;
 
-			FActorSpawnParameters SpawnParams;
-			SpawnParams.Owner = this;
-			SpawnParams.bNoFail = true;
-			SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+			// If we're dropping the whole stack, the pickup takes the item itself. Otherwise take some off the stack and the pickup makes a new item.
+			const int32 DroppedQuantity = bDropWholeStack ? ItemQuantity : PlayerInventory->ConsumeItem(Item, Quantity);
+
+			// RemoveItem fails if the item isn't actually in our inventory, in which case it isn't ours to drop
+			if (bDropWholeStack && !PlayerInventory->RemoveItem(Item))
+			{
+				return;
+			}
 
 			FVector SpawnLocation = GetActorLocation();
 
@@ -137,8 +171,48 @@ void ASurvivalCharacter::DropItem(class UItem* Item, int32 Quantity)
 
 			ensure(PickupClass);
 
-			APickup* Pickup = GetWorld()->SpawnActor<APickup>(PickupClass, SpawnTransform, SpawnParams);
-			Pickup->InitializePickup(Item->GetClass(), DroppedQuantity);
+			// Top up stacks of the same item already on the ground nearby first, so dropping things one at a time doesn't litter the world with pickups
+			UPickupPoolSubsystem* PickupPool = UPickupPoolSubsystem::Get(this);
+
+			const int32 MergedQuantity = PickupPool ? PickupPool->MergeIntoNearbyDrops(Item->GetClass(), DroppedQuantity, SpawnLocation) : 0;
+			const int32 RemainingQuantity = DroppedQuantity - MergedQuantity;
+
+			if (RemainingQuantity <= 0)
+			{
+				if (bDropWholeStack)
+				{
+					UItemPool::DestroyItem(Item);
+				}
+				return;
+			}
+
+			if (bDropWholeStack && MergedQuantity > 0)
+			{
+				Item->SetQuantity(RemainingQuantity);
+			}
+
+			// The pickup is set up before it finishes spawning, so clients get it complete in one bunch
+			auto InitializeDroppedPickup = [&](APickup* Pickup)
+			{
+				if (bDropWholeStack)
+				{
+					Pickup->InitializePickupWithItem(Item);
+				}
+				else
+				{
+					Pickup->InitializePickup(Item->GetClass(), RemainingQuantity);
+				}
+			};
+
+			// Reuse a pickup someone took earlier if we can, rather than spawning a new one
+			if (!PickupPool || !PickupPool->AcquirePickup(PickupClass, SpawnTransform, this, InitializeDroppedPickup))
+			{
+				if (APickup* Pickup = GetWorld()->SpawnActorDeferred<APickup>(PickupClass, SpawnTransform, this, nullptr, ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn))
+				{
+					InitializeDroppedPickup(Pickup);
+					Pickup->FinishSpawning(SpawnTransform);
+				}
+			}
 		}
 	}
 }
@@ -274,57 +348,176 @@ void ASurvivalCharacter::Tick(float DeltaTime)
 	Super::Tick(DeltaTime);
 
 
-	const bool bIsInteractingOnServer = (HasAuthority() && IsInteracting());
+	// Only the player looking through this character checks what they're looking at. The server validates the target they send it instead
+	EInteractionCheckRate CheckRate = EInteractionCheckRate::None;
 
-	if ((!HasAuthority() || bIsInteractingOnServer) && GetWorld()->TimeSince(InteractionData.LastInteractionCheckTime) > InteractionCheckFrequency)
+	if (IsLocallyControlled() && ShouldPerformInteractionCheck(CheckRate))
 	{
-		PerformInteractionCheck();
+		if (PerformInteractionCheck())
+		{
+			InteractionCheckStats.NumIdleChecks += CheckRate == EInteractionCheckRate::Idle ? 1 : 0;
+			InteractionCheckStats.NumMovingChecks += CheckRate == EInteractionCheckRate::Moving ? 1 : 0;
+			InteractionCheckStats.NumFastChecks += CheckRate == EInteractionCheckRate::Fast ? 1 : 0;
+		}
+		else if (CheckRate != EInteractionCheckRate::None)
+		{
+			InteractionCheckStats.NumSkippedPending++;
+		}
 	}
 }
 
 
-void ASurvivalCharacter::PerformInteractionCheck()
+bool ASurvivalCharacter::PerformInteractionCheck(const bool bForceSync /*= false*/)
 {
 
 	if (GetController() == nullptr)
 	{
-		return;
+		return false;
 	}
 
-	InteractionData.LastInteractionCheckTime = GetWorld()->GetTimeSeconds();
+	UInteractionSubsystem* Interactions = bUseInteractionRegistry ? UInteractionSubsystem::Get(this) : nullptr;
+
+	// Wait for the trace we already have in flight rather than queueing another one
+	if (!Interactions && !bForceSync && bUseAsyncInteractionTrace && PendingInteractionTrace.IsValid())
+	{
+		return false;
+	}
 
 	FVector EyesLoc;
 	FRotator EyesRot;
 
 	GetController()->GetPlayerViewPoint(EyesLoc, EyesRot);
 
+	InteractionData.LastInteractionCheckTime = GetWorld()->GetTimeSeconds();
+	InteractionData.LastInteractionCheckLocation = EyesLoc;
+	InteractionData.LastInteractionCheckRotation = EyesRot;
+
+	if (Interactions)
+	{
+		if (UInteractionComponent* InteractionComponent = Interactions->FindBestInteractable(EyesLoc, EyesRot.Vector(), InteractionCheckDistance, InteractionViewConeAngle, InteractionTraceChannel, this))
+		{
+			if (InteractionComponent != GetInteractable())
+			{
+				FoundNewInteractable(InteractionComponent);
+			}
+		}
+		else
+		{
+			CouldntFindInteractable();
+		}
+
+		return true;
+	}
+
 	FVector TraceStart = EyesLoc;
 	FVector TraceEnd = (EyesRot.Vector() * InteractionCheckDistance) + TraceStart;
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(InteractionCheck), false, this);
+
+	if (bUseAsyncInteractionTrace && !bForceSync)
+	{
+		PendingInteractionTrace = GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Single, TraceStart, TraceEnd, InteractionTraceChannel, QueryParams, FCollisionResponseParams::DefaultResponseParam, &InteractionTraceDelegate);
+		return true;
+	}
+
+	// Anything still in flight is older than this, so drop it when it comes back
+	PendingInteractionTrace = FTraceHandle();
+
 	FHitResult TraceHit;
 
-	FCollisionQueryParams QueryParams;
-	QueryParams.AddIgnoredActor(this);
+	const bool bHit = GetWorld()->LineTraceSingleByChannel(TraceHit, TraceStart, TraceEnd, InteractionTraceChannel, QueryParams);
+	ProcessInteractionTrace(TraceStart, bHit ? &TraceHit : nullptr);
+	return true;
+}
+
+bool ASurvivalCharacter::ShouldPerformInteractionCheck(EInteractionCheckRate& OutCheckRate)
+{
+	const float TimeSinceCheck = GetWorld()->TimeSince(InteractionData.LastInteractionCheckTime);
+
+	if (!bAdaptiveInteractionCheck)
+	{
+		return TimeSinceCheck > InteractionCheckFrequency;
+	}
+
+	if (GetController() == nullptr)
+	{
+		return false;
+	}
+
+	FVector EyesLoc;
+	FRotator EyesRot;
 
-	if (GetWorld()->LineTraceSingleByChannel(TraceHit, TraceStart, TraceEnd, ECC_Visibility, QueryParams))
+	GetController()->GetPlayerViewPoint(EyesLoc, EyesRot);
+
+	const float DistanceMoved = FVector::Dist(EyesLoc, InteractionData.LastInteractionCheckLocation);
+	const float DegreesTurned = FMath::RadiansToDegrees(FMath::Acos(FMath::Clamp(EyesRot.Vector() | InteractionData.LastInteractionCheckRotation.Vector(), -1.f, 1.f)));
+
+	// Nothing we can see has changed from our point of view, but things can still move into view, so check now and again
+	if (DistanceMoved < InteractionCheckMinViewMove && DegreesTurned < InteractionCheckMinViewTurn)
 	{
-		// Check if we hit an interactable object
-		if (TraceHit.GetActor())
+		if (TimeSinceCheck >= InteractionCheckIdleFrequency)
 		{
-			if (UInteractionComponent *InteractionComponent = Cast<UInteractionComponent>(TraceHit.GetActor()->GetComponentByClass(UInteractionComponent::StaticClass())))
-			{
-				float Distance = (TraceStart - TraceHit.ImpactPoint).Size();
+			OutCheckRate = EInteractionCheckRate::Idle;
+			return true;
+		}
 
-				if (InteractionComponent != GetInteractable() && Distance <= InteractionComponent->InteractionDistance)
-				{
-					FoundNewInteractable(InteractionComponent);
-				}
-				else if (Distance > InteractionComponent->InteractionDistance && GetInteractable())
-				{
-					CouldntFindInteractable();
-				}
+		InteractionCheckStats.NumSkippedUnchanged++;
+		return false;
+	}
 
-				return;
+	// While the camera is whipping around check every chance we get so focus keeps up, otherwise a slightly slower rate is plenty
+	const float SafeTimeSinceCheck = FMath::Max(TimeSinceCheck, KINDA_SMALL_NUMBER);
+	const bool bMovingFast = DegreesTurned / SafeTimeSinceCheck >= InteractionCheckFastTurnRate || DistanceMoved / SafeTimeSinceCheck >= InteractionCheckFastMoveSpeed;
+
+	if (TimeSinceCheck >= (bMovingFast ? InteractionCheckFastFrequency : InteractionCheckMovingFrequency))
+	{
+		OutCheckRate = bMovingFast ? EInteractionCheckRate::Fast : EInteractionCheckRate::Moving;
+		return true;
+	}
+
+	InteractionCheckStats.NumSkippedRateLimited++;
+	return false;
+}
+
+void ASurvivalCharacter::OnInteractionTraceCompleted(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum)
+{
+	// Ignore anything that isn't the trace we're waiting for
+	if (TraceHandle != PendingInteractionTrace)
+	{
+		return;
+	}
+
+	PendingInteractionTrace = FTraceHandle();
+
+	// The controller may have gone away in the frame since the trace was queued
+	if (GetController() == nullptr)
+	{
+		return;
+	}
+
+	const FHitResult* TraceHit = TraceDatum.OutHits.Num() > 0 && TraceDatum.OutHits[0].bBlockingHit ? &TraceDatum.OutHits[0] : nullptr;
+	ProcessInteractionTrace(TraceDatum.Start, TraceHit);
+}
+
+void ASurvivalCharacter::ProcessInteractionTrace(const FVector& TraceStart, const FHitResult* TraceHit)
+{
+	// Check if we hit an interactable object
+	if (TraceHit && TraceHit->GetActor())
+	{
+		if (UInteractionComponent *InteractionComponent = Cast<UInteractionComponent>(TraceHit->GetActor()->GetComponentByClass(UInteractionComponent::StaticClass())))
+		{
+			float Distance = (TraceStart - TraceHit->ImpactPoint).Size();
+
+			if (InteractionComponent != GetInteractable() && Distance <= InteractionComponent->InteractionDistance)
+			{
+				FoundNewInteractable(InteractionComponent);
+			}
+			else if (Distance > InteractionComponent->InteractionDistance && GetInteractable())
+			{
+				CouldntFindInteractable();
 			}
+
+			return;
 		}
 	}
 
@@ -368,20 +561,23 @@ void ASurvivalCharacter::FoundNewInteractable(UInteractionComponent* Interactabl
 
 void ASurvivalCharacter::BeginInteract()
 {
+	/** Clients send the server the interactable they're focused on. The server validates it once here and rechecks it cheaply when
+	the interact completes, rather than searching for an interactable itself, or checking every tick during a timed interact. */
 	if (!HasAuthority())
 	{
-		ServerBeginInteract();
+		ServerBeginInteract(GetInteractable());
 	}
-
-	/** As an optimization, the server only checks that we're looking at an item once we begin interacting with it.
-	This saves the server doing a check every tick for an interactable Item. The exception is a non-instant interact.
-	In this case, the server will check every tick for the duration of the interact*/
-	if (HasAuthority())
+	else
 	{
-		PerformInteractionCheck();
-
+		// A listen server's own player, make sure focus is up to date
+		PerformInteractionCheck(true);
 	}
 
+	StartInteract();
+}
+
+void ASurvivalCharacter::StartInteract()
+{
 	InteractionData.bInteractHeld = true;
 
 	if (UInteractionComponent* Interactable = GetInteractable())
@@ -416,13 +612,82 @@ void ASurvivalCharacter::EndInteract()
 	}
 }
 
-void ASurvivalCharacter::ServerBeginInteract_Implementation()
+void ASurvivalCharacter::ServerBeginInteract_Implementation(class UInteractionComponent* Target)
+{
+	if (UInteractionSubsystem* Interactions = UInteractionSubsystem::Get(this))
+	{
+		Interactions->NumBeginValidations++;
+	}
+
+	if (!ValidateInteractable(Target, true))
+	{
+		CouldntFindInteractable();
+		return;
+	}
+
+	if (Target != GetInteractable())
+	{
+		FoundNewInteractable(Target);
+	}
+
+	StartInteract();
+}
+
+bool ASurvivalCharacter::ServerBeginInteract_Validate(class UInteractionComponent* Target)
 {
-	BeginInteract();
+	return true;
 }
 
-bool ASurvivalCharacter::ServerBeginInteract_Validate()
+bool ASurvivalCharacter::ValidateInteractable(class UInteractionComponent* Interactable, const bool bCheckLineOfSight)
 {
+	SCOPE_CYCLE_COUNTER(STAT_ValidateInteract);
+
+	// Keeps the validation counts too. Every world has one, so without it there's nothing to validate against
+	UInteractionSubsystem* Interactions = UInteractionSubsystem::Get(this);
+
+	if (!Interactions || !Interactable || !Interactable->IsActive() || !Interactable->GetOwner() || Interactable->GetOwner()->IsPendingKillPending() || GetController() == nullptr)
+	{
+		if (Interactions)
+		{
+			Interactions->NumRejectedInvalid++;
+		}
+		return false;
+	}
+
+	FVector EyesLoc;
+	FRotator EyesRot;
+
+	GetController()->GetPlayerViewPoint(EyesLoc, EyesRot);
+
+	const USceneComponent* Root = Interactable->GetOwner()->GetRootComponent();
+	const float BoundsRadius = Root ? Root->Bounds.SphereRadius : 0.f;
+	const FVector ToInteractable = UInteractionSubsystem::GetInteractableLocation(Interactable) - EyesLoc;
+	const float Distance = ToInteractable.Size();
+
+	if (Distance > Interactable->InteractionDistance + BoundsRadius + ServerInteractDistanceTolerance)
+	{
+		Interactions->NumRejectedDistance++;
+		return false;
+	}
+
+	// Up close the middle of a big interactable can be well off centre while we're still looking right at it
+	if (Distance > BoundsRadius && (ToInteractable / Distance | EyesRot.Vector()) < FMath::Cos(FMath::DegreesToRadians(ServerInteractConeAngle)))
+	{
+		Interactions->NumRejectedCone++;
+		return false;
+	}
+
+	if (bCheckLineOfSight)
+	{
+		Interactions->NumLineOfSightTraces++;
+
+		if (!Interactions->IsInteractableVisible(EyesLoc, Interactable, InteractionTraceChannel, this))
+		{
+			Interactions->NumRejectedLineOfSight++;
+			return false;
+		}
+	}
+
 	return true;
 }
 
@@ -442,6 +707,21 @@ void ASurvivalCharacter::Interact()
 
 	if (UInteractionComponent* Interactable = GetInteractable())
 	{
+		// We validated the interactable when the interact began, so just make sure the player is still in reach and facing it
+		if (HasAuthority() && !IsLocallyControlled())
+		{
+			if (UInteractionSubsystem* Interactions = UInteractionSubsystem::Get(this))
+			{
+				Interactions->NumInteractRechecks++;
+			}
+
+			if (!ValidateInteractable(Interactable, false))
+			{
+				EndInteract();
+				return;
+			}
+		}
+
 		Interactable->Interact(this);
 	}
 }
@@ -467,3 +747,31 @@ void ASurvivalCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputC
 
 }
 
+#if !UE_BUILD_SHIPPING
+static FAutoConsoleCommandWithWorldAndArgs InteractionCheckStatsCommand(
+	TEXT("SurvivalGame.Interaction.CheckStats"),
+	TEXT("Logs how many interaction checks the adaptive scheduler ran and skipped for each locally controlled character. Pass 'reset' to clear the counts afterwards."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		const bool bReset = Args.Num() > 0 && Args[0] == TEXT("reset");
+
+		for (TActorIterator<ASurvivalCharacter> It(World); It; ++It)
+		{
+			if (It->IsLocallyControlled())
+			{
+				const FInteractionCheckStats& Stats = It->GetInteractionCheckStats();
+				const int32 NumChecks = Stats.NumIdleChecks + Stats.NumMovingChecks + Stats.NumFastChecks;
+				const int32 NumSkipped = Stats.NumSkippedUnchanged + Stats.NumSkippedRateLimited + Stats.NumSkippedPending;
+
+				UE_LOG(LogTemp, Log, TEXT("%s: %d interaction checks (%d idle, %d moving, %d fast), %d skipped (%d view unchanged, %d rate limited, %d waiting on a trace), %.1f%% of ticks saved"),
+					*It->GetName(), NumChecks, Stats.NumIdleChecks, Stats.NumMovingChecks, Stats.NumFastChecks, NumSkipped, Stats.NumSkippedUnchanged, Stats.NumSkippedRateLimited, Stats.NumSkippedPending,
+					NumChecks + NumSkipped > 0 ? 100.f * NumSkipped / (NumChecks + NumSkipped) : 0.f);
+
+				if (bReset)
+				{
+					It->ResetInteractionCheckStats();
+				}
+			}
+		}
+	}));
+#endif
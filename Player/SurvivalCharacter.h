@@ -7,9 +7,37 @@
 #include "Items/EquippableItem.h"
 #include "Delegates/Delegate.h"
 #include "Components/SkeletalMeshComponent.h"
+#include "WorldCollision.h"
 #include "SurvivalGame/Components/InteractionComponent.h"
 #include "SurvivalCharacter.generated.h"
 
+// Why the adaptive interaction check did or didn't run each tick, so we can see how many checks it saves
+struct FInteractionCheckStats
+{
+	FInteractionCheckStats() : NumIdleChecks(0), NumMovingChecks(0), NumFastChecks(0), NumSkippedUnchanged(0), NumSkippedRateLimited(0), NumSkippedPending(0) {};
+
+	// Checks run because the idle rate was due, the view was moving, or the view was moving fast
+	int32 NumIdleChecks;
+	int32 NumMovingChecks;
+	int32 NumFastChecks;
+
+	// Checks skipped because the view hadn't changed, or because it had but the check for that speed wasn't due yet
+	int32 NumSkippedUnchanged;
+	int32 NumSkippedRateLimited;
+
+	// Checks that were due, but skipped because the last async trace hadn't come back yet
+	int32 NumSkippedPending;
+};
+
+// Which rate the adaptive interaction check was due at. None when the check isn't adaptive
+enum class EInteractionCheckRate : uint8
+{
+	None,
+	Idle,
+	Moving,
+	Fast
+};
+
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnEquippedItemsChanged, const EEquippableSlot, Slot, const UEquippableItem*, Item);
 
 UCLASS()
@@ -73,11 +101,74 @@ protected:
 	UPROPERTY(EditAnywhere, Category = "Interaction")
 	float InteractionCheckFrequency;
 
+	// If set, InteractionCheckFrequency is ignored and checks are scheduled based on how much the view has changed since the last one
+	UPROPERTY(EditAnywhere, Category = "Interaction|Scheduling")
+	bool bAdaptiveInteractionCheck;
+
+	// The view has to move further than this, or turn more than InteractionCheckMinViewTurn degrees, to count as changed
+	UPROPERTY(EditAnywhere, Category = "Interaction|Scheduling", meta = (EditCondition = bAdaptiveInteractionCheck))
+	float InteractionCheckMinViewMove;
+
+	UPROPERTY(EditAnywhere, Category = "Interaction|Scheduling", meta = (EditCondition = bAdaptiveInteractionCheck))
+	float InteractionCheckMinViewTurn;
+
+	// How often to check while the view hasn't changed, in case something moved in front of us
+	UPROPERTY(EditAnywhere, Category = "Interaction|Scheduling", meta = (EditCondition = bAdaptiveInteractionCheck))
+	float InteractionCheckIdleFrequency;
+
+	// How often to check while the view is changing
+	UPROPERTY(EditAnywhere, Category = "Interaction|Scheduling", meta = (EditCondition = bAdaptiveInteractionCheck))
+	float InteractionCheckMovingFrequency;
+
+	// How often to check while the view is changing faster than InteractionCheckFastTurnRate (degrees/s) or InteractionCheckFastMoveSpeed
+	UPROPERTY(EditAnywhere, Category = "Interaction|Scheduling", meta = (EditCondition = bAdaptiveInteractionCheck))
+	float InteractionCheckFastFrequency;
+
+	UPROPERTY(EditAnywhere, Category = "Interaction|Scheduling", meta = (EditCondition = bAdaptiveInteractionCheck))
+	float InteractionCheckFastTurnRate;
+
+	UPROPERTY(EditAnywhere, Category = "Interaction|Scheduling", meta = (EditCondition = bAdaptiveInteractionCheck))
+	float InteractionCheckFastMoveSpeed;
+
+	// Decide whether this tick needs an interaction check, and which rate it's due at. Skipped checks are counted here, checks that run
+	// are counted once PerformInteractionCheck() has actually traced or queried
+	bool ShouldPerformInteractionCheck(EInteractionCheckRate& OutCheckRate);
+
+	FInteractionCheckStats InteractionCheckStats;
+
 	// How far we'll trace when we check if the player is looking at an interactable object
 	UPROPERTY(EditAnywhere, Category = "Interaction")
 	float InteractionCheckDistance;
 
-	void PerformInteractionCheck();
+	// The channel the interaction check traces on. Only primitives that block this channel can be found or stand in the way
+	UPROPERTY(EditAnywhere, Category = "Interaction")
+	TEnumAsByte<ECollisionChannel> InteractionTraceChannel;
+
+	// If set, the regular interaction check queues an async trace and acts on the result next frame instead of tracing on the game thread
+	UPROPERTY(EditAnywhere, Category = "Interaction")
+	bool bUseAsyncInteractionTrace;
+
+	// If set, the interaction check asks the interaction subsystem for the best interactable in view instead of tracing for one. Only the final occlusion check traces
+	UPROPERTY(EditAnywhere, Category = "Interaction")
+	bool bUseInteractionRegistry;
+
+	// How far off the centre of the screen, in degrees, an interactable can be and still get focus when using the interaction registry
+	UPROPERTY(EditAnywhere, Category = "Interaction", meta = (EditCondition = bUseInteractionRegistry, ClampMin = 0.0, ClampMax = 90.0))
+	float InteractionViewConeAngle;
+
+	/** Check for an interactable in front of the player.
+	@param bForceSync trace straight away even if bUseAsyncInteractionTrace is set, for when we need the answer now (ie the server validating an interact)
+	@return true if a trace or registry query was issued, false if there was nothing to check with or an async trace is still in flight */
+	bool PerformInteractionCheck(const bool bForceSync = false);
+
+	// Focus on or lose focus of whatever the interaction trace found
+	void ProcessInteractionTrace(const FVector& TraceStart, const FHitResult* TraceHit);
+
+	void OnInteractionTraceCompleted(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum);
+
+	// The async interaction trace in flight, if any. We only ever have one
+	FTraceHandle PendingInteractionTrace;
+	FTraceDelegate InteractionTraceDelegate;
 
 	void CouldntFindInteractable();
 	void FoundNewInteractable(UInteractionComponent* Interactable);
@@ -85,13 +176,28 @@ protected:
 	void BeginInteract();
 	void EndInteract();
 
+	// Start interacting with whatever we're focused on. Shared by the local BeginInteract() and the server once it has validated the client's target
+	void StartInteract();
+
+	/** The client tells the server what it's interacting with, so the server only has to check it once instead of searching for it */
 	UFUNCTION(Server, Reliable, WithValidation)
-	void ServerBeginInteract();
+	void ServerBeginInteract(class UInteractionComponent* Target);
 	UFUNCTION(Server, Reliable, WithValidation)
 	void ServerEndInteract();
 
 	void Interact();
 
+	/** [Server] Check a client could really be interacting with an interactable: it's in reach and in front of them and, if bCheckLineOfSight, not behind a wall */
+	bool ValidateInteractable(class UInteractionComponent* Interactable, const bool bCheckLineOfSight);
+
+	// How far off the centre of a client's view, in degrees, the server allows their interact target to be. Generous, since the view the server has is a little behind
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction|Validation")
+	float ServerInteractConeAngle;
+
+	// Extra distance the server allows on top of InteractionDistance, to cover movement the server hasn't seen yet
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction|Validation")
+	float ServerInteractDistanceTolerance;
+
 	// Information about the current state of the players interaction
 	UPROPERTY()
 	FInteractionData InteractionData;
@@ -109,6 +215,9 @@ public:
 	// Get the time till we interact with the current interactable
 	float GetRemainingInteractTime() const;
 
+	FORCEINLINE const FInteractionCheckStats& GetInteractionCheckStats() const { return InteractionCheckStats; };
+	FORCEINLINE void ResetInteractionCheckStats() { InteractionCheckStats = FInteractionCheckStats(); };
+
 	// Items
 
 	/** [Server] Use an item from our inventory. */
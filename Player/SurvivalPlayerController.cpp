@@ -2,4 +2,104 @@
 
 
 #include "Player/SurvivalPlayerController.h"
+#include "Components/InteractionComponent.h"
+#include "Widgets/InteractionWidget.h"
+#include "Blueprint/UserWidget.h"
 
+ASurvivalPlayerController::ASurvivalPlayerController()
+{
+	InteractionWidget = nullptr;
+}
+
+void ASurvivalPlayerController::PlayerTick(float DeltaTime)
+{
+	Super::PlayerTick(DeltaTime);
+
+	if (InteractionWidgetTarget.IsValid())
+	{
+		UpdateInteractionWidgetPosition();
+	}
+	else if (InteractionWidget && InteractionWidget->GetVisibility() != ESlateVisibility::Collapsed)
+	{
+		// Whatever we were showing the prompt for was destroyed without ending focus, so there's nothing left to point at
+		InteractionWidgetTarget = nullptr;
+		InteractionWidget->SetVisibility(ESlateVisibility::Collapsed);
+	}
+}
+
+void ASurvivalPlayerController::ShowInteractionWidget(class UInteractionComponent* Interactable)
+{
+	if (!Interactable || !IsLocalController())
+	{
+		return;
+	}
+
+	if (!InteractionWidget)
+	{
+		TSubclassOf<UInteractionWidget> WidgetClass = InteractionWidgetClass ? InteractionWidgetClass : Interactable->InteractionWidgetClass;
+
+		if (!WidgetClass)
+		{
+			return;
+		}
+
+		InteractionWidget = CreateWidget<UInteractionWidget>(this, WidgetClass);
+		InteractionWidget->SetAlignmentInViewport(FVector2D(0.5f, 0.5f));
+		InteractionWidget->AddToViewport();
+	}
+
+	InteractionWidgetTarget = Interactable;
+	InteractionWidget->UpdateInteractionWidget(Interactable);
+	InteractionWidget->SetVisibility(ESlateVisibility::HitTestInvisible);
+
+	UpdateInteractionWidgetPosition();
+}
+
+void ASurvivalPlayerController::HideInteractionWidget(class UInteractionComponent* Interactable)
+{
+	// Focus may have already moved on to another interactable, in which case it owns the widget now. An interactable that's
+	// being destroyed is still ours to hide, so look through pending kill, and hide anyway if the target has gone altogether
+	if (InteractionWidget && (InteractionWidgetTarget.Get(true) == Interactable || !InteractionWidgetTarget.IsValid(true)))
+	{
+		InteractionWidgetTarget = nullptr;
+		InteractionWidget->SetVisibility(ESlateVisibility::Collapsed);
+	}
+}
+
+void ASurvivalPlayerController::RefreshInteractionWidget(class UInteractionComponent* Interactable)
+{
+	if (InteractionWidget && InteractionWidgetTarget.Get() == Interactable)
+	{
+		InteractionWidget->UpdateInteractionWidget(Interactable);
+	}
+}
+
+class UInteractionWidget* ASurvivalPlayerController::GetInteractionWidget(const class UInteractionComponent* Interactable) const
+{
+	return InteractionWidgetTarget.Get() == Interactable ? InteractionWidget : nullptr;
+}
+
+void ASurvivalPlayerController::UpdateInteractionWidgetPosition()
+{
+	if (!InteractionWidget)
+	{
+		return;
+	}
+
+	FVector2D ScreenPosition;
+
+	if (ProjectWorldLocationToScreen(InteractionWidgetTarget->GetWidgetLocation(), ScreenPosition, true))
+	{
+		InteractionWidget->SetPositionInViewport(ScreenPosition, false);
+
+		if (InteractionWidget->GetVisibility() != ESlateVisibility::HitTestInvisible)
+		{
+			InteractionWidget->SetVisibility(ESlateVisibility::HitTestInvisible);
+		}
+	}
+	else if (InteractionWidget->GetVisibility() != ESlateVisibility::Collapsed)
+	{
+		// The target is behind the camera, so there's nowhere on screen to put the prompt. A screen space widget component would hide here too
+		InteractionWidget->SetVisibility(ESlateVisibility::Collapsed);
+	}
+}
@@ -13,5 +13,38 @@ UCLASS()
 class SURVIVALGAME_API ASurvivalPlayerController : public APlayerController
 {
 	GENERATED_BODY()
-	
+
+public:
+
+	ASurvivalPlayerController();
+
+	virtual void PlayerTick(float DeltaTime) override;
+
+	/** [Local] Point the shared interaction widget at an interactable and show it. Used by interactables in IWM_SharedHUD mode */
+	void ShowInteractionWidget(class UInteractionComponent* Interactable);
+
+	/** [Local] Hide the shared interaction widget, if it's still showing this interactable */
+	void HideInteractionWidget(class UInteractionComponent* Interactable);
+
+	/** [Local] Update the shared interaction widget, if it's showing this interactable */
+	void RefreshInteractionWidget(class UInteractionComponent* Interactable);
+
+	/** The shared interaction widget, if it's currently showing this interactable */
+	class UInteractionWidget* GetInteractionWidget(const class UInteractionComponent* Interactable) const;
+
+protected:
+
+	// The prompt shown for interactables in IWM_SharedHUD mode. If unset, the InteractionWidgetClass of the first interactable we focus is used
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction")
+	TSubclassOf<class UInteractionWidget> InteractionWidgetClass;
+
+	// The one interaction widget this player has, created the first time it's needed
+	UPROPERTY(Transient)
+	class UInteractionWidget* InteractionWidget;
+
+	// The interactable the shared widget is showing
+	TWeakObjectPtr<class UInteractionComponent> InteractionWidgetTarget;
+
+	// Keep the shared widget over the interactable it's showing, and hidden while the interactable is off screen, like a screen space widget component would
+	void UpdateInteractionWidgetPosition();
 };
@@ -4,3 +4,9 @@
 
 #include "CoreMinimal.h"
 
+/** Trace channel for finding things the player can interact with. Add it as "Interactable" under [/Script/Engine.CollisionProfile]
+in the project's DefaultEngine.ini with a default response of Ignore, so the trace skips everything that hasn't opted in:
++DefaultChannelResponses=(Channel=ECC_GameTraceChannel1,DefaultResponse=ECR_Ignore,bTraceType=True,bStaticObject=False,Name="Interactable")
+Interactables block it themselves, see APickup. Walls and other geometry that should hide interactables need Block added to their
+collision presets. Until that's set up characters keep tracing on ECC_Visibility, see ASurvivalCharacter::InteractionTraceChannel */
+#define COLLISION_INTERACTABLE ECC_GameTraceChannel1
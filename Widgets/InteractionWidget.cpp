@@ -3,9 +3,47 @@
 
 #include "Widgets/InteractionWidget.h"
 #include "Components/InteractionComponent.h"
+#include "Engine/World.h"
 
 void UInteractionWidget::UpdateInteractionWidget(class UInteractionComponent* InteractionComponent)
 {
+	// The shared widget gets pointed at different interactables, and progress on the last one doesn't carry over
+	if (OwningInteractionComponent != InteractionComponent)
+	{
+		bInteracting = false;
+	}
+
 	OwningInteractionComponent = InteractionComponent;
 	OnUpdateInteractionWidget();
 }
+
+void UInteractionWidget::NotifyInteractStarted(const float StartTime, const float Duration)
+{
+	bInteracting = true;
+	InteractStartTime = StartTime;
+	InteractDuration = Duration;
+	OnInteractStarted(Duration);
+}
+
+void UInteractionWidget::NotifyInteractCancelled()
+{
+	bInteracting = false;
+	OnInteractCancelled();
+}
+
+void UInteractionWidget::NotifyInteractCompleted()
+{
+	bInteracting = false;
+	OnInteractCompleted();
+}
+
+float UInteractionWidget::GetInteractProgress() const
+{
+	if (!bInteracting)
+	{
+		return 0.f;
+	}
+
+	const UWorld* World = GetWorld();
+	return InteractDuration > 0.f && World ? FMath::Clamp((World->GetTimeSeconds() - InteractStartTime) / InteractDuration, 0.f, 1.f) : 1.f;
+}
@@ -26,5 +26,33 @@ public:
 
 	UPROPERTY(BlueprintReadOnly, Category = "Interaction", meta = (ExposeOnSpawn))
 	class UInteractionComponent *OwningInteractionComponent;
+
+	// Called by the interaction component when the local player starts, stops or finishes interacting with it
+	void NotifyInteractStarted(const float StartTime, const float Duration);
+	void NotifyInteractCancelled();
+	void NotifyInteractCompleted();
+
+	//Return a value from 0-1 denoting how far through the local player's interact we are. Worked out from when it started, so it's cheap to bind to
+	UFUNCTION(BlueprintPure, Category = "Interaction")
+	float GetInteractProgress() const;
+
+	UFUNCTION(BlueprintPure, Category = "Interaction")
+	FORCEINLINE bool IsInteracting() const { return bInteracting; };
+
+	// Start a progress animation here instead of polling. Duration is 0 for instant interacts
+	UFUNCTION(BlueprintImplementableEvent)
+	void OnInteractStarted(float Duration);
+
+	UFUNCTION(BlueprintImplementableEvent)
+	void OnInteractCancelled();
+
+	UFUNCTION(BlueprintImplementableEvent)
+	void OnInteractCompleted();
+
+protected:
+
+	bool bInteracting;
+	float InteractStartTime;
+	float InteractDuration;
 	
 };
@@ -0,0 +1,332 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "World/InteractionSubsystem.h"
+#include "Components/InteractionComponent.h"
+#include "Engine/World.h"
+#include "Engine/EngineBaseTypes.h"
+#include "HAL/IConsoleManager.h"
+
+UInteractionSubsystem::UInteractionSubsystem()
+{
+	CellSize = 500.f;
+	MaxOcclusionTraces = 3;
+	DistanceScoreWeight = 0.1f;
+
+	NumQueries = 0;
+	NumEntriesScanned = 0;
+	NumOcclusionTraces = 0;
+	NumHighlightRequests = 0;
+	NumHighlightChanges = 0;
+	NumHighlightCacheRebuilds = 0;
+	NumBeginValidations = 0;
+	NumInteractRechecks = 0;
+	NumLineOfSightTraces = 0;
+	NumRejectedInvalid = 0;
+	NumRejectedDistance = 0;
+	NumRejectedCone = 0;
+	NumRejectedLineOfSight = 0;
+
+	NumInteractables = 0;
+	MaxReach = 0.f;
+}
+
+void UInteractionSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &UInteractionSubsystem::OnWorldPostActorTick);
+}
+
+void UInteractionSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+	PendingHighlights.Empty();
+
+	Super::Deinitialize();
+}
+
+UInteractionSubsystem* UInteractionSubsystem::Get(const UObject* WorldContextObject)
+{
+	if (UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr)
+	{
+		return World->GetSubsystem<UInteractionSubsystem>();
+	}
+	return nullptr;
+}
+
+void UInteractionSubsystem::RegisterInteractable(class UInteractionComponent* Interactable)
+{
+	if (Interactable && Interactable->GridIndex == INDEX_NONE)
+	{
+		AddEntry(Interactable);
+		++NumInteractables;
+	}
+}
+
+void UInteractionSubsystem::UnregisterInteractable(class UInteractionComponent* Interactable)
+{
+	if (Interactable && Interactable->GridIndex != INDEX_NONE)
+	{
+		RemoveEntry(Interactable);
+		--NumInteractables;
+	}
+}
+
+void UInteractionSubsystem::UpdateInteractable(class UInteractionComponent* Interactable)
+{
+	if (!Interactable || Interactable->GridIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	const FVector NewLocation = GetInteractableLocation(Interactable);
+
+	if (GetCell(NewLocation) == Interactable->GridCell)
+	{
+		// Most moves stay inside the cell, ie a pickup settling on the ground
+		FInteractableEntry& Entry = Cells.FindChecked(Interactable->GridCell)[Interactable->GridIndex];
+		Entry.Location = NewLocation;
+	}
+	else
+	{
+		RemoveEntry(Interactable);
+		AddEntry(Interactable);
+	}
+}
+
+FIntVector UInteractionSubsystem::GetCell(const FVector& Location) const
+{
+	return FIntVector(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize), FMath::FloorToInt(Location.Z / CellSize));
+}
+
+FVector UInteractionSubsystem::GetInteractableLocation(const class UInteractionComponent* Interactable)
+{
+	const AActor* Owner = Interactable->GetOwner();
+	const USceneComponent* Root = Owner ? Owner->GetRootComponent() : nullptr;
+
+	return Root ? Root->Bounds.Origin : Interactable->GetComponentLocation();
+}
+
+void UInteractionSubsystem::AddEntry(class UInteractionComponent* Interactable)
+{
+	const AActor* Owner = Interactable->GetOwner();
+	const USceneComponent* Root = Owner ? Owner->GetRootComponent() : nullptr;
+
+	FInteractableEntry Entry;
+	Entry.Location = GetInteractableLocation(Interactable);
+	Entry.Reach = Interactable->InteractionDistance + (Root ? Root->Bounds.SphereRadius : 0.f);
+	Entry.Interactable = Interactable;
+
+	MaxReach = FMath::Max(MaxReach, Entry.Reach);
+
+	Interactable->GridCell = GetCell(Entry.Location);
+	Interactable->GridIndex = Cells.FindOrAdd(Interactable->GridCell).Add(Entry);
+}
+
+void UInteractionSubsystem::RemoveEntry(class UInteractionComponent* Interactable)
+{
+	TArray<FInteractableEntry>& Cell = Cells.FindChecked(Interactable->GridCell);
+
+	Cell.RemoveAtSwap(Interactable->GridIndex, 1, false);
+
+	// Whatever was swapped into the removed slot needs its index fixing
+	if (Cell.IsValidIndex(Interactable->GridIndex))
+	{
+		Cell[Interactable->GridIndex].Interactable->GridIndex = Interactable->GridIndex;
+	}
+	else if (Cell.Num() == 0)
+	{
+		Cells.Remove(Interactable->GridCell);
+	}
+
+	Interactable->GridIndex = INDEX_NONE;
+}
+
+class UInteractionComponent* UInteractionSubsystem::FindBestInteractable(const FVector& ViewLocation, const FVector& ViewDirection, const float MaxDistance, const float ConeHalfAngle, const ECollisionChannel TraceChannel, const AActor* IgnoreActor)
+{
+	++NumQueries;
+
+	const float SearchRadius = FMath::Min(MaxDistance, MaxReach);
+
+	if (SearchRadius <= 0.f)
+	{
+		return nullptr;
+	}
+
+	const float MinDot = FMath::Cos(FMath::DegreesToRadians(ConeHalfAngle));
+	const FIntVector MinCell = GetCell(ViewLocation - FVector(SearchRadius));
+	const FIntVector MaxCell = GetCell(ViewLocation + FVector(SearchRadius));
+
+	struct FCandidate
+	{
+		float Score;
+		UInteractionComponent* Interactable;
+	};
+
+	// Only the best few are worth tracing to, so keep a small sorted list rather than sorting everything we looked at
+	TArray<FCandidate, TInlineAllocator<8>> Candidates;
+	const int32 MaxCandidates = FMath::Max(MaxOcclusionTraces, 1);
+
+	for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+		{
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z)
+			{
+				const TArray<FInteractableEntry>* Cell = Cells.Find(FIntVector(X, Y, Z));
+
+				if (!Cell)
+				{
+					continue;
+				}
+
+				NumEntriesScanned += Cell->Num();
+
+				for (const FInteractableEntry& Entry : *Cell)
+				{
+					const FVector ToEntry = Entry.Location - ViewLocation;
+					const float Range = FMath::Min(Entry.Reach, MaxDistance);
+					const float DistanceSquared = ToEntry.SizeSquared();
+
+					if (DistanceSquared > FMath::Square(Range) || Entry.Interactable->GetOwner() == IgnoreActor)
+					{
+						continue;
+					}
+
+					const float Distance = FMath::Sqrt(DistanceSquared);
+					const float Dot = Distance > KINDA_SMALL_NUMBER ? (ToEntry | ViewDirection) / Distance : 1.f;
+
+					if (Dot < MinDot)
+					{
+						continue;
+					}
+
+					const float Score = Dot - DistanceScoreWeight * (Distance / SearchRadius);
+
+					if (Candidates.Num() < MaxCandidates || Score > Candidates.Last().Score)
+					{
+						int32 InsertIndex = Candidates.Num();
+
+						while (InsertIndex > 0 && Candidates[InsertIndex - 1].Score < Score)
+						{
+							--InsertIndex;
+						}
+
+						Candidates.Insert(FCandidate{ Score, Entry.Interactable }, InsertIndex);
+
+						if (Candidates.Num() > MaxCandidates)
+						{
+							Candidates.Pop(false);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	for (const FCandidate& Candidate : Candidates)
+	{
+		if (IsInteractableVisible(ViewLocation, Candidate.Interactable, TraceChannel, IgnoreActor))
+		{
+			return Candidate.Interactable;
+		}
+	}
+
+	return nullptr;
+}
+
+bool UInteractionSubsystem::IsInteractableVisible(const FVector& ViewLocation, const class UInteractionComponent* Interactable, const ECollisionChannel TraceChannel, const AActor* IgnoreActor)
+{
+	++NumOcclusionTraces;
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(InteractionOcclusion), false, IgnoreActor);
+	FHitResult Hit;
+
+	// Hitting the interactable itself, or nothing at all, means there's nothing in the way
+	if (GetWorld()->LineTraceSingleByChannel(Hit, ViewLocation, GetInteractableLocation(Interactable), TraceChannel, QueryParams))
+	{
+		return Hit.GetActor() == Interactable->GetOwner();
+	}
+
+	return true;
+}
+
+void UInteractionSubsystem::RequestHighlight(class UInteractionComponent* Interactable)
+{
+	++NumHighlightRequests;
+
+	if (Interactable && !Interactable->bHighlightQueued)
+	{
+		Interactable->bHighlightQueued = true;
+		PendingHighlights.Add(Interactable);
+	}
+}
+
+void UInteractionSubsystem::OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	// Interaction checks happen during the character's tick, so by now focus has settled for this frame
+	if (World == GetWorld() && PendingHighlights.Num())
+	{
+		FlushHighlights();
+	}
+}
+
+void UInteractionSubsystem::FlushHighlights()
+{
+	for (const TWeakObjectPtr<UInteractionComponent>& Pending : PendingHighlights)
+	{
+		if (UInteractionComponent* Interactable = Pending.Get())
+		{
+			Interactable->bHighlightQueued = false;
+
+			if (Interactable->ApplyHighlight())
+			{
+				++NumHighlightChanges;
+			}
+		}
+	}
+
+	PendingHighlights.Reset();
+}
+
+#if !UE_BUILD_SHIPPING
+static FAutoConsoleCommandWithWorld InteractionRegistryStatsCommand(
+	TEXT("SurvivalGame.Interaction.RegistryStats"),
+	TEXT("Logs how many interactables are registered for the current world, and how much work the interaction queries have done."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UInteractionSubsystem* Interactions = World ? World->GetSubsystem<UInteractionSubsystem>() : nullptr)
+		{
+			const int32 NumQueries = FMath::Max(Interactions->NumQueries, 1);
+
+			UE_LOG(LogTemp, Log, TEXT("Interaction registry: %d interactables, %d queries, %.1f entries scanned and %.2f occlusion traces per query"),
+				Interactions->GetNumInteractables(), Interactions->NumQueries, (float)Interactions->NumEntriesScanned / NumQueries, (float)Interactions->NumOcclusionTraces / NumQueries);
+			UE_LOG(LogTemp, Log, TEXT("Interaction highlights: %d requested, %d applied, %d highlight primitive cache rebuilds"),
+				Interactions->NumHighlightRequests, Interactions->NumHighlightChanges, Interactions->NumHighlightCacheRebuilds);
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs InteractValidationStatsCommand(
+	TEXT("SurvivalGame.Interaction.ValidationStats"),
+	TEXT("Logs how many client interacts the server has validated and rejected, and how many traces that took. Pass 'reset' to clear the counts afterwards. Use 'stat game' for the time spent."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UInteractionSubsystem* Interactions = World ? World->GetSubsystem<UInteractionSubsystem>() : nullptr;
+
+		if (!Interactions)
+		{
+			return;
+		}
+
+		UE_LOG(LogTemp, Log, TEXT("Interact validation: %d begins, %d rechecks, %d line of sight traces. Rejected: %d invalid, %d too far, %d outside the view cone, %d out of sight"),
+			Interactions->NumBeginValidations, Interactions->NumInteractRechecks, Interactions->NumLineOfSightTraces, Interactions->NumRejectedInvalid,
+			Interactions->NumRejectedDistance, Interactions->NumRejectedCone, Interactions->NumRejectedLineOfSight);
+
+		if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+		{
+			Interactions->NumBeginValidations = Interactions->NumInteractRechecks = Interactions->NumLineOfSightTraces = 0;
+			Interactions->NumRejectedInvalid = Interactions->NumRejectedDistance = Interactions->NumRejectedCone = Interactions->NumRejectedLineOfSight = 0;
+		}
+	}));
+#endif
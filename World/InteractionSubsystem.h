@@ -0,0 +1,116 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "InteractionSubsystem.generated.h"
+
+/**
+ * Keeps every active interaction component in a uniform grid, so finding what a player is looking at is a scan over a few
+ * cells instead of a physics trace followed by a component search on whatever the trace hit. A trace is only needed
+ * at the end to check the best candidates aren't behind a wall. Cheap enough for the server to validate interacts with.
+ */
+UCLASS(Config = Game)
+class SURVIVALGAME_API UInteractionSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	UInteractionSubsystem();
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/** Get the interaction subsystem for the world the given object is in */
+	static UInteractionSubsystem* Get(const UObject* WorldContextObject);
+
+	/** Called by interaction components when they start/stop being interactable, and when they move */
+	void RegisterInteractable(class UInteractionComponent* Interactable);
+	void UnregisterInteractable(class UInteractionComponent* Interactable);
+	void UpdateInteractable(class UInteractionComponent* Interactable);
+
+	/** Find the interactable a viewer is most likely looking at: the one closest to the middle of the view cone that is within its
+	InteractionDistance and MaxDistance, and isn't hidden behind anything that blocks TraceChannel. Returns null if there isn't one.
+	@param ConeHalfAngle in degrees. Interactables further off centre than this are ignored */
+	class UInteractionComponent* FindBestInteractable(const FVector& ViewLocation, const FVector& ViewDirection, const float MaxDistance, const float ConeHalfAngle, const ECollisionChannel TraceChannel, const AActor* IgnoreActor);
+
+	/** True if nothing blocking TraceChannel is between ViewLocation and the interactable */
+	bool IsInteractableVisible(const FVector& ViewLocation, const class UInteractionComponent* Interactable, const ECollisionChannel TraceChannel, const AActor* IgnoreActor);
+
+	/** The point queries measure to and trace at, the middle of the owning actor's root component */
+	static FVector GetInteractableLocation(const class UInteractionComponent* Interactable);
+
+	FORCEINLINE int32 GetNumInteractables() const { return NumInteractables; };
+
+	/** Queue an interactable's highlight to be turned on or off. Requests are applied together once actors have ticked,
+	so focus flicking between several interactables in one frame only touches render state for the ones that end up changed */
+	void RequestHighlight(class UInteractionComponent* Interactable);
+
+	// How many queries were run, how many registered interactables they looked at, and how many occlusion traces they needed
+	int32 NumQueries;
+	int32 NumEntriesScanned;
+	int32 NumOcclusionTraces;
+
+	// How many highlight changes were requested, how many actually changed an interactable's highlight, and how often highlight primitives had to be found again
+	int32 NumHighlightRequests;
+	int32 NumHighlightChanges;
+	int32 NumHighlightCacheRebuilds;
+
+	// [Server] How many client interacts were validated when they began and rechecked when they went through, how many line of sight
+	// traces that took, and how many were rejected for being invalid, too far, outside the view cone or out of sight
+	int32 NumBeginValidations;
+	int32 NumInteractRechecks;
+	int32 NumLineOfSightTraces;
+	int32 NumRejectedInvalid;
+	int32 NumRejectedDistance;
+	int32 NumRejectedCone;
+	int32 NumRejectedLineOfSight;
+
+protected:
+
+	// The size of each grid cell. Roughly the largest InteractionDistance works well
+	UPROPERTY(Config)
+	float CellSize;
+
+	// The most candidates a query will trace to before deciding nothing is visible
+	UPROPERTY(Config)
+	int32 MaxOcclusionTraces;
+
+	// How much being further away counts against a candidate compared to being off centre
+	UPROPERTY(Config)
+	float DistanceScoreWeight;
+
+private:
+
+	struct FInteractableEntry
+	{
+		FVector Location;
+
+		// How far from Location a viewer can be and still interact: InteractionDistance plus the size of the actor
+		float Reach;
+
+		class UInteractionComponent* Interactable;
+	};
+
+	// Entries are kept by value in their cell, so a query reads them straight through without chasing pointers
+	TMap<FIntVector, TArray<FInteractableEntry>> Cells;
+
+	int32 NumInteractables;
+
+	// The largest Reach registered, which bounds how many cells a query has to look at. Never shrinks
+	float MaxReach;
+
+	FIntVector GetCell(const FVector& Location) const;
+	void AddEntry(class UInteractionComponent* Interactable);
+	void RemoveEntry(class UInteractionComponent* Interactable);
+
+	// Interactables waiting for their highlight to be applied. Each is only in here once, see UInteractionComponent::bHighlightQueued
+	TArray<TWeakObjectPtr<class UInteractionComponent>> PendingHighlights;
+
+	FDelegateHandle PostActorTickHandle;
+
+	void OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+	void FlushHighlights();
+};
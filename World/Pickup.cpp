@@ -2,19 +2,32 @@
 
 
 #include "World/Pickup.h"
+#include "SurvivalGame.h"
+#include "World/PickupPoolSubsystem.h"
+#include "World/PickupPlacementSubsystem.h"
+#include "World/PickupCleanupSubsystem.h"
 #include "Items/Item.h"
+#include "Items/ItemPool.h"
+#include "Items/ItemCatalog.h"
 #include "Player/SurvivalCharacter.h"
 #include "Components/StaticMeshComponent.h"
 #include "Components/InteractionComponent.h"
 #include "Components/InventoryComponent.h"
-#include "Engine/ActorChannel.h"
 #include "Net/UnrealNetwork.h"
+#include "Engine/NetDriver.h"
+#include "Engine/NetConnection.h"
+#include "Engine/ActorChannel.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "Serialization/BitWriter.h"
+#include "UObject/UObjectIterator.h"
 
 // Sets default values
 APickup::APickup()
 {
 	PickupMesh = CreateDefaultSubobject<UStaticMeshComponent>("PickupMesh");
 	PickupMesh->SetCollisionResponseToChannel(ECC_Pawn, ECR_Ignore);
+	PickupMesh->SetCollisionResponseToChannel(COLLISION_INTERACTABLE, ECR_Block);
 
 	SetRootComponent(PickupMesh);
 
@@ -27,41 +40,375 @@ APickup::APickup()
 	InteractionComponent->SetupAttachment(PickupMesh);
 
 	SetReplicates(true);
+
+	/** Pickups only need replicating when their item changes, which UpdatePickupState() wakes us up for.
+	Pickups placed in the map start dormant and clients already have them, so they cost nothing until someone takes from them */
+	NetDormancy = DORM_Initial;
+
+	NetSettingsByRarity.Add(EItemRarity::IR_Common, FPickupNetSettings(6000.f, 1.f, 0.25f));
+	NetSettingsByRarity.Add(EItemRarity::IR_Uncommon, FPickupNetSettings(8000.f, 1.f, 0.25f));
+	NetSettingsByRarity.Add(EItemRarity::IR_Rare, FPickupNetSettings(10000.f, 2.f, 0.5f));
+	NetSettingsByRarity.Add(EItemRarity::IR_VeryRare, FPickupNetSettings(12000.f, 2.f, 0.5f));
+	NetSettingsByRarity.Add(EItemRarity::IR_Legendary, FPickupNetSettings(15000.f, 4.f, 1.f));
+
+	bCreateItemLazily = true;
+	LazyQuantity = 0;
+
+	bFromPool = false;
+	bPooled = false;
+	ReuseCount = 0;
+
+	bAlignWithGroundNatively = true;
+	bSettleWithPhysics = false;
+	MaxSettleTime = 2.f;
+	bPlacementQueued = false;
+	DropCell = FIntVector::ZeroValue;
+	bFiledAsDrop = false;
+	CleanupTrackId = 0;
+	CleanupRegion = FIntVector::ZeroValue;
+	CleanupDropTime = 0.f;
+	bCleanupTracked = false;
 }
 
 void APickup::InitializePickup(const TSubclassOf<class UItem> ItemClass, const int32 Quantity)
 {
 	if (HasAuthority() && ItemClass && Quantity > 0)
 	{
-		Item = NewObject<UItem>(this, ItemClass);
-		Item->SetQuantity(Quantity);
+		if (Item)
+		{
+			UItemPool::DestroyItem(Item);
+		}
+
+		LazyItemClass = nullptr;
 
-		OnRep_Item();
+		// Clamped here as well as by SetQuantity(), so this and InitializePickupLazily() plainly end up with the same stack
+		Item = UItemPool::CreateItem(this, ItemClass);
+		Item->SetQuantity(FMath::Min(Quantity, Item->GetMaxStackSize()));
 
-		Item->MarkDirtyForReplication();
+		UpdatePickupState();
 	}
 }
 
-void APickup::OnRep_Item()
+void APickup::InitializePickupLazily(const TSubclassOf<class UItem> ItemClass, const int32 Quantity)
 {
+	if (HasAuthority() && ItemClass && Quantity > 0)
+	{
+		if (Item)
+		{
+			UItemPool::DestroyItem(Item);
+			Item = nullptr;
+		}
+
+		// The same clamp SetQuantity() applies when InitializePickup() creates the item, so both paths hold the same stack
+		LazyItemClass = ItemClass;
+		LazyQuantity = FMath::Min(Quantity, ItemClass->GetDefaultObject<UItem>()->GetMaxStackSize());
+
+		UpdatePickupState();
+	}
+}
+
+class UItem* APickup::EnsureItem()
+{
+	if (!Item && LazyItemClass && HasAuthority())
+	{
+		Item = UItemPool::CreateItem(this, LazyItemClass);
+		Item->SetQuantity(LazyQuantity);
+
+		LazyItemClass = nullptr;
+		LazyQuantity = 0;
+
+		if (UPickupPoolSubsystem* Pool = UPickupPoolSubsystem::Get(this))
+		{
+			Pool->NumItemsMaterialized++;
+		}
+	}
+
+	return Item;
+}
+
+int32 APickup::AddToStack(const int32 Amount)
+{
+	if (!HasAuthority() || Amount <= 0)
+	{
+		return 0;
+	}
+
+	// Lazy pickups just remember the bigger quantity, so merging into one doesn't create its item
+	if (!Item && LazyItemClass)
+	{
+		const int32 AddAmount = FMath::Min(Amount, LazyItemClass->GetDefaultObject<UItem>()->GetMaxStackSize() - LazyQuantity);
+		LazyQuantity += FMath::Max(AddAmount, 0);
+		UpdatePickupState();
+		return FMath::Max(AddAmount, 0);
+	}
+
+	if (!Item || !Item->IsStackable())
+	{
+		return 0;
+	}
+
+	const int32 AddAmount = FMath::Max(FMath::Min(Amount, Item->GetMaxStackSize() - Item->GetQuantity()), 0);
+	Item->SetQuantity(Item->GetQuantity() + AddAmount);
+	UpdatePickupState();
+	return AddAmount;
+}
+
+void APickup::InitializePickup(const FItemId ItemId, const int32 Quantity)
+{
+	if (const UItemCatalog* Catalog = UItemCatalog::Get(this))
+	{
+		InitializePickup(Catalog->GetItemClass(ItemId), Quantity);
+	}
+}
+
+void APickup::InitializePickupWithItem(class UItem* InItem)
+{
+	if (HasAuthority() && InItem && InItem->GetQuantity() > 0)
+	{
+		// The item must not still be in an inventory, use UInventoryComponent::RemoveItem() first
+		ensure(InItem->OwningInventory == nullptr);
+
+		if (Item)
+		{
+			UItemPool::DestroyItem(Item);
+		}
+
+		LazyItemClass = nullptr;
+
+		// Dropped items have been replicated to their old owner's clients, so this is usually a fresh copy
+		Item = InItem->MoveToOuter(this);
+
+		UpdatePickupState();
+	}
+}
+
+void APickup::UpdatePickupState()
+{
+	FPickupReplicatedState NewState;
+
 	if (Item)
 	{
-		PickupMesh->SetStaticMesh(Item->PickUpMesh);
-		InteractionComponent->InteractableNameText = Item->ItemDisplayName;
+		NewState = FPickupReplicatedState(Item->GetItemId(), Item->GetQuantity());
+	}
+	else if (LazyItemClass)
+	{
+		NewState = FPickupReplicatedState(UItem::GetItemIdOfClass(LazyItemClass, this), LazyQuantity);
+	}
+
+	if (NewState.Quantity > 0 && !NewState.ItemId.IsValid())
+	{
+		// Items that aren't in the catalog, or games without one, have no ID to send, so send the class instead. Rebuild the catalog after adding items
+		NewState.ItemClass = Item ? Item->GetClass() : *LazyItemClass;
+	}
+
+	if (NewState != PickupState)
+	{
+		// Every merge, take and reuse changes the state, so only warn the first time we see each class. Weak, since Blueprint classes
+		// are unloaded and recompiled between PIE sessions, and a new class could otherwise turn up at a stale pointer's address
+		static TSet<TWeakObjectPtr<UClass>> WarnedItemClasses;
+
+		const TWeakObjectPtr<UClass> UncataloguedClass = *NewState.ItemClass;
+
+		if (UncataloguedClass.IsValid() && !WarnedItemClasses.Contains(UncataloguedClass))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s: %s isn't in the item catalog, so the pickup replicates its class instead of an item ID"), *GetNameSafe(this), *GetNameSafe(NewState.ItemClass));
+			WarnedItemClasses.Add(UncataloguedClass);
+		}
 
-		// Clients bind to this delegate in order to refresh the interaction widget if the item quantity changes
-		Item->OnItemModified.AddDynamic(this, &APickup::OnItemModified);
+		PickupState = NewState;
+
+		// We're dormant between changes, so the new state has to wake us. Nothing has been sent before we've begun play
+		if (HasActorBegunPlay())
+		{
+			FlushNetDormancy();
+		}
+	}
+
+	ApplyNetSettings();
+	OnRep_PickupState();
+}
+
+void APickup::OnRep_PickupState()
+{
+	if (const UItem* ItemDefaults = GetItemDefaults())
+	{
+		// Everything shown comes from the item's definition, which the class defaults share with every instance
+		PickupMesh->SetStaticMesh(ItemDefaults->GetPickUpMesh());
+		InteractionComponent->InteractableNameText = ItemDefaults->GetDisplayName();
+		InteractionComponent->Activate();
+	}
+	else if (bPooled || !HasAuthority())
+	{
+		// We've gone back to the pool. Forget the last item so a stale mesh or name never shows when we're reused
+		PickupMesh->SetStaticMesh(nullptr);
+		InteractionComponent->InteractableNameText = GetClass()->GetDefaultObject<APickup>()->InteractionComponent->InteractableNameText;
+		InteractionComponent->Deactivate();
 	}
 
-	// If any replicated properties on the item are changed, we refresh the widget
+	// The quantity may have changed, so refresh the widget
 	InteractionComponent->RefreshWidget();
 }
 
-void APickup::OnItemModified()
+class UItem* APickup::GetItemDefaults() const
+{
+	if (!PickupState.IsValid())
+	{
+		return nullptr;
+	}
+
+	// Same class, so the server can skip the catalog lookup
+	if (Item || LazyItemClass)
+	{
+		return Item ? Item->GetClass()->GetDefaultObject<UItem>() : LazyItemClass->GetDefaultObject<UItem>();
+	}
+
+	if (PickupState.ItemClass)
+	{
+		return PickupState.ItemClass->GetDefaultObject<UItem>();
+	}
+
+	const UItemCatalog* Catalog = UItemCatalog::Get(this);
+	const TSubclassOf<UItem> ItemClass = Catalog ? Catalog->GetItemClass(PickupState.ItemId) : nullptr;
+
+	return ItemClass ? ItemClass->GetDefaultObject<UItem>() : nullptr;
+}
+
+void APickup::ApplyNetSettings()
+{
+	const UItem* ItemDefaults = HasAuthority() ? GetItemDefaults() : nullptr;
+
+	if (const FPickupNetSettings* Settings = ItemDefaults ? NetSettingsByRarity.Find(ItemDefaults->GetRarity()) : nullptr)
+	{
+		NetCullDistanceSquared = FMath::Square(Settings->NetCullDistance);
+		NetUpdateFrequency = Settings->NetUpdateFrequency;
+		MinNetUpdateFrequency = FMath::Min(Settings->MinNetUpdateFrequency, Settings->NetUpdateFrequency);
+	}
+}
+
+void APickup::OnAcquiredFromPool(const FTransform& Transform)
+{
+	bPooled = false;
+
+	// Send the new location once. We go back to sleep afterwards, like any other dropped pickup
+	FlushNetDormancy();
+
+	SetActorTransform(Transform, false, nullptr, ETeleportType::ResetPhysics);
+
+	Placement.Location = Transform.GetLocation();
+	Placement.Rotation = Transform.Rotator();
+	++ReuseCount;
+
+	// Same as when a dropped pickup begins play
+	RequestPlacement();
+}
+
+void APickup::OnReleasedToPool()
+{
+	bPooled = true;
+
+	if (PickupMesh->IsSimulatingPhysics())
+	{
+		PickupMesh->SetSimulatePhysics(false);
+	}
+
+	if (Item)
+	{
+		UItemPool::DestroyItem(Item);
+		Item = nullptr;
+	}
+
+	LazyItemClass = nullptr;
+
+	/** The empty state is what hides us. OnRep_PickupState() clears the mesh and turns interaction off on every machine. Hiding the actor
+	or turning off its collision would make it irrelevant to everyone, so clients that already had it dormant would never hear it was taken */
+	UpdatePickupState();
+}
+
+void APickup::OnRep_Placement()
 {
-	if (InteractionComponent)
+	SetActorLocationAndRotation(Placement.Location, Placement.Rotation, false, nullptr, ETeleportType::ResetPhysics);
+
+	// Natively placed pickups are already on the ground. Blueprint placed ones do it themselves on every machine
+	if (!bAlignWithGroundNatively)
 	{
-		InteractionComponent->RefreshWidget();
+		AlignWithGround();
+	}
+}
+
+void APickup::RequestPlacement()
+{
+	if (!bAlignWithGroundNatively)
+	{
+		AlignWithGround();
+	}
+	else if (HasAuthority())
+	{
+		if (UPickupPlacementSubsystem* PlacementSubsystem = UPickupPlacementSubsystem::Get(this))
+		{
+			PlacementSubsystem->RequestPlacement(this);
+		}
+	}
+}
+
+void APickup::PlaceOnGround(const FHitResult& GroundHit)
+{
+	// Keep facing the way we were dropped, but tilt to match the slope we landed on
+	const FRotator GroundRotation = FRotationMatrix::MakeFromZX(GroundHit.ImpactNormal, GetActorForwardVector()).Rotator();
+
+	SetActorLocationAndRotation(GroundHit.ImpactPoint, GroundRotation, false, nullptr, ETeleportType::ResetPhysics);
+}
+
+bool APickup::StartSettling()
+{
+	if (!bSettleWithPhysics || MaxSettleTime <= 0.f || !PickupMesh->GetBodyInstance() || !PickupMesh->IsCollisionEnabled())
+	{
+		return false;
+	}
+
+	PickupMesh->SetSimulatePhysics(true);
+	return PickupMesh->IsSimulatingPhysics();
+}
+
+void APickup::FinishPlacement()
+{
+	if (PickupMesh->IsSimulatingPhysics())
+	{
+		// Stopping the simulation leaves the mesh where physics put it, which is where the actor is now
+		PickupMesh->SetSimulatePhysics(false);
+		PickupMesh->SetPhysicsLinearVelocity(FVector::ZeroVector);
+		PickupMesh->SetPhysicsAngularVelocityInDegrees(FVector::ZeroVector);
+	}
+
+	Placement.Location = GetActorLocation();
+	Placement.Rotation = GetActorRotation();
+
+	// File the drop under where it came to rest, so later drops around here can still merge into it
+	if (UPickupPoolSubsystem* Pool = bFiledAsDrop ? UPickupPoolSubsystem::Get(this) : nullptr)
+	{
+		Pool->UpdateDrop(this);
+	}
+
+	// Likewise for the region cleanup counts us in
+	if (UPickupCleanupSubsystem* Cleanup = bCleanupTracked ? UPickupCleanupSubsystem::Get(this) : nullptr)
+	{
+		Cleanup->UpdatePickup(this);
+	}
+
+	// Dropped pickups are dormant, so wake up long enough to send where we ended up
+	FlushNetDormancy();
+}
+
+void APickup::DestroyOrRelease()
+{
+	UPickupPoolSubsystem* Pool = bFromPool ? UPickupPoolSubsystem::Get(this) : nullptr;
+
+	if (Pool)
+	{
+		Pool->ReleasePickup(this);
+	}
+	else
+	{
+		Destroy();
 	}
 }
 
@@ -72,19 +419,54 @@ void APickup::BeginPlay()
 	
 	if (HasAuthority() && ItemTemplate && bNetStartup)
 	{
-		InitializePickup(ItemTemplate->GetClass(), ItemTemplate->GetQuantity());
+		const double StartSeconds = FPlatformTime::Seconds();
+
+		if (bCreateItemLazily)
+		{
+			InitializePickupLazily(ItemTemplate->GetClass(), ItemTemplate->GetQuantity());
+		}
+		else
+		{
+			InitializePickup(ItemTemplate->GetClass(), ItemTemplate->GetQuantity());
+		}
+
+		// Counted here rather than in InitializePickupLazily(), which promoted pickup records go through as well
+		if (UPickupPoolSubsystem* Pool = UPickupPoolSubsystem::Get(this))
+		{
+			Pool->NumStartupPickups++;
+			Pool->NumLazyPickups += bCreateItemLazily ? 1 : 0;
+			Pool->StartupInitSeconds += FPlatformTime::Seconds() - StartSeconds;
+		}
+	}
+	else if (!HasAuthority() && ItemTemplate && bNetStartup && !PickupState.IsValid())
+	{
+		// Map placed pickups stay dormant, so clients may not get our state until someone takes from us. The template has everything the prompt needs
+		InteractionComponent->InteractableNameText = ItemTemplate->GetDisplayName();
+	}
+
+	// Dropped pickups replicate once when they're spawned, then sleep until their item changes
+	if (HasAuthority() && !bNetStartup)
+	{
+		SetNetDormancy(DORM_DormantAll);
 	}
 
 	/** If pickup was spawned in at the runtime, ensure that it matches the rotation of the ground that it was dropped on
 	If we dropped a pickup on a 20 degree slope, the pickup would also be spawned at a 20 degree angle */
 	if (!bNetStartup)
 	{
-		AlignWithGround();
+		RequestPlacement();
 	}
+}
 
-	if (Item)
+void APickup::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	Super::EndPlay(EndPlayReason);
+
+	// Nothing else references the item once the pickup is gone, so let another pickup or inventory reuse it
+	if (HasAuthority() && Item)
 	{
-		Item->MarkDirtyForReplication();
+		UItemPool::DestroyItem(Item);
+		Item = nullptr;
 	}
 }
 
@@ -92,19 +474,8 @@ void APickup::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeP
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
-	DOREPLIFETIME(APickup, Item);
-}
-
-bool APickup::ReplicateSubobjects(class UActorChannel* Channel, class FOutBunch* Bunch, FReplicationFlags* RepFlags)
-{
-	bool bWroteSomething = Super::ReplicateSubobjects(Channel, Bunch, RepFlags);
-
-	if (Item && Channel->KeyNeedsToReplicate(Item->GetUniqueID(), Item->RepKey))
-	{
-		bWroteSomething |= Channel->ReplicateSubobject(Item, *Bunch, *RepFlags);
-	}
-
-	return bWroteSomething;
+	DOREPLIFETIME(APickup, PickupState);
+	DOREPLIFETIME(APickup, Placement);
 }
 
 #if WITH_EDITOR
@@ -119,7 +490,7 @@ void APickup::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent
 	{
 		if (ItemTemplate)
 		{
-			PickupMesh->SetStaticMesh(ItemTemplate->PickUpMesh);
+			PickupMesh->SetStaticMesh(ItemTemplate->GetPickUpMesh());
 		}
 	}
 }
@@ -134,24 +505,127 @@ void APickup::OnTakePickup(class ASurvivalCharacter* Taker)
 	}
 
 	// Not 100% Pending Kill check is needed but should prevent player from taking a pickup another player has already tried taking
-	if (HasAuthority() && !IsPendingKillPending() && Item)
+	if (HasAuthority() && !IsPendingKillPending() && !bPooled && EnsureItem())
 	{
 		if (UInventoryComponent* PlayerInventory = Taker->PlayerInventory)
 		{
-			const FItemAddResult AddResult = PlayerInventory->TryAddItem(Item);
-			if (AddResult.ActualAmountGiven < Item->GetQuantity())
+			// Hand our item straight to the inventory if it can take the whole stack, rather than having it make a copy
+			const int32 PickupQuantity = Item->GetQuantity();
+			const FItemAddResult AddResult = PlayerInventory->TryTransferItem(Item);
+
+			if (Item->OwningInventory == PlayerInventory)
+			{
+				// The inventory owns our item now, so forget about it and don't let EndPlay() recycle it
+				Item = nullptr;
+				DestroyOrRelease();
+			}
+			else if (AddResult.ActualAmountGiven < PickupQuantity)
 			{
-				Item->SetQuantity(Item->GetQuantity() - AddResult.ActualAmountGiven);
+				Item->SetQuantity(PickupQuantity - AddResult.ActualAmountGiven);
+				UpdatePickupState();
 			}
-			else if (AddResult.ActualAmountGiven >= Item->GetQuantity())
+			else
 			{
-				Destroy();
+				// All of it was given, merged into a stack or copied because our item had already been replicated
+				DestroyOrRelease();
 			}
 		}
 	}
 }
 
+#if !UE_BUILD_SHIPPING
+static FAutoConsoleCommandWithWorld PickupNetStatsCommand(
+	TEXT("SurvivalGame.Pickups.NetStats"),
+	TEXT("[Server] Logs how many pickups in the current world have an actor channel open to some client rather than being dormant or not relevant, split by whether they were placed in the map, and how many bits a pickup's replicated state takes. Compare with the ServerReplicateActors time in stat net."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		const UNetDriver* NetDriver = World ? World->GetNetDriver() : nullptr;
+
+		if (!NetDriver || !NetDriver->IsServer())
+		{
+			UE_LOG(LogTemp, Log, TEXT("Pickup net stats need a server world"));
+			return;
+		}
+
+		int32 NumStartup = 0;
+		int32 NumStartupAwake = 0;
+		int32 NumDynamic = 0;
+		int32 NumDynamicAwake = 0;
+		int32 NumOpenChannels = 0;
+
+		for (TActorIterator<APickup> It(World); It; ++It)
+		{
+			// NetDormancy is only what we asked for. A dormant actor's channels are closed, so count the ones that are really open
+			int32 NumPickupChannels = 0;
+
+			for (UNetConnection* Connection : NetDriver->ClientConnections)
+			{
+				NumPickupChannels += Connection && Connection->FindActorChannelRef(TWeakObjectPtr<AActor>(*It)) ? 1 : 0;
+			}
+
+			const bool bAwake = NumPickupChannels > 0;
+			NumOpenChannels += NumPickupChannels;
+
+			if (It->bNetStartup)
+			{
+				++NumStartup;
+				NumStartupAwake += bAwake ? 1 : 0;
+			}
+			else
+			{
+				++NumDynamic;
+				NumDynamicAwake += bAwake ? 1 : 0;
+			}
+		}
+
+		UE_LOG(LogTemp, Log, TEXT("Pickups: %d placed in the map (%d with an open channel), %d spawned (%d with an open channel). %d pickup channels open over %d connections"),
+			NumStartup, NumStartupAwake, NumDynamic, NumDynamicAwake, NumOpenChannels, NetDriver->ClientConnections.Num());
+
+		// What a pickup's state costs on the wire, before property and bunch headers
+		FBitWriter SmallStack(0, true);
+		FBitWriter LargeStack(0, true);
+		bool bSuccess = false;
+
+		FPickupReplicatedState(FItemId(1), 1).NetSerialize(SmallStack, nullptr, bSuccess);
+		FPickupReplicatedState(FItemId(1), 1000).NetSerialize(LargeStack, nullptr, bSuccess);
+
+		UE_LOG(LogTemp, Log, TEXT("Pickup state is %lld bits for a single item, %lld bits for a stack of 1000"), SmallStack.GetNumBits(), LargeStack.GetNumBits());
+	}));
 
+static FAutoConsoleCommandWithWorldAndArgs PickupItemStatsCommand(
+	TEXT("SurvivalGame.Pickups.ItemStats"),
+	TEXT("Logs how long map placed pickups took to set up, how many are waiting to create their item, and how many item objects are alive. Usage: SurvivalGame.Pickups.ItemStats [reset]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UPickupPoolSubsystem* Pool = World ? World->GetSubsystem<UPickupPoolSubsystem>() : nullptr;
+
+		if (!Pool)
+		{
+			return;
+		}
+
+		if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+		{
+			Pool->NumStartupPickups = Pool->NumLazyPickups = Pool->NumItemsMaterialized = 0;
+			Pool->StartupInitSeconds = 0.0;
+			return;
+		}
 
+		int32 NumWaiting = 0;
 
+		for (TActorIterator<APickup> It(World); It; ++It)
+		{
+			NumWaiting += It->GetItem() == nullptr && It->GetQuantity() > 0 ? 1 : 0;
+		}
 
+		int32 NumItems = 0;
+
+		for (TObjectIterator<UItem> It; It; ++It)
+		{
+			NumItems += It->GetWorld() == World && !It->IsTemplate() ? 1 : 0;
+		}
+
+		UE_LOG(LogTemp, Log, TEXT("%d map placed pickups set up in %.2f ms, %d of them lazily. %d items created on demand, %d pickups still waiting. %d item objects alive"),
+			Pool->NumStartupPickups, Pool->StartupInitSeconds * 1000.0, Pool->NumLazyPickups, Pool->NumItemsMaterialized, NumWaiting, NumItems);
+	}));
+#endif
@@ -4,13 +4,119 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Items/ItemId.h"
+#include "Items/ItemDefinition.h"
+#include "Engine/NetSerialization.h"
 #include "Pickup.generated.h"
 
+// Everything clients need to show a pickup. Replicated in place of the pickup's item, which only the server has
+USTRUCT(BlueprintType)
+struct FPickupReplicatedState
+{
+	GENERATED_BODY()
+
+	FPickupReplicatedState() : ItemClass(nullptr), Quantity(0) {};
+	FPickupReplicatedState(const FItemId InItemId, const int32 InQuantity) : ItemId(InItemId), ItemClass(nullptr), Quantity(InQuantity) {};
+
+	UPROPERTY(BlueprintReadOnly, Category = "Pickup")
+	FItemId ItemId;
+
+	// Only set for items that aren't in the catalog, so they have no ID. Sent as a class reference instead, which costs a lot more
+	UPROPERTY(BlueprintReadOnly, Category = "Pickup")
+	TSubclassOf<class UItem> ItemClass;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Pickup")
+	int32 Quantity;
+
+	FORCEINLINE bool IsValid() const { return (ItemId.IsValid() || ItemClass) && Quantity > 0; };
+
+	FORCEINLINE bool operator==(const FPickupReplicatedState& Other) const { return ItemId == Other.ItemId && ItemClass == Other.ItemClass && Quantity == Other.Quantity; };
+	FORCEINLINE bool operator!=(const FPickupReplicatedState& Other) const { return !(*this == Other); };
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess)
+	{
+		bOutSuccess = true;
+
+		// One bit says which of the ID or the class follows
+		uint8 bHasItemId = ItemId.IsValid() || !ItemClass;
+		Ar.SerializeBits(&bHasItemId, 1);
+
+		if (bHasItemId)
+		{
+			Ar << ItemId;
+			ItemClass = nullptr;
+		}
+		else
+		{
+			UObject* ClassObject = *ItemClass;
+			bOutSuccess &= Map->SerializeObject(Ar, UClass::StaticClass(), ClassObject);
+			ItemClass = Cast<UClass>(ClassObject);
+			ItemId = FItemId();
+		}
+
+		// Almost every pickup is a small stack, which packs into a byte
+		uint32 PackedQuantity = (uint32)FMath::Max(Quantity, 0);
+		Ar.SerializeIntPacked(PackedQuantity);
+		Quantity = (int32)PackedQuantity;
+
+		return true;
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FPickupReplicatedState> : public TStructOpsTypeTraitsBase2<FPickupReplicatedState>
+{
+	enum
+	{
+		WithNetSerializer = true,
+		WithIdenticalViaEquality = true,
+	};
+};
+
+// How a pickup replicates, picked by the rarity of its item
+USTRUCT(BlueprintType)
+struct FPickupNetSettings
+{
+	GENERATED_BODY()
+
+	FPickupNetSettings() : NetCullDistance(10000.f), NetUpdateFrequency(2.f), MinNetUpdateFrequency(0.5f) {};
+	FPickupNetSettings(const float InNetCullDistance, const float InNetUpdateFrequency, const float InMinNetUpdateFrequency)
+		: NetCullDistance(InNetCullDistance), NetUpdateFrequency(InNetUpdateFrequency), MinNetUpdateFrequency(InMinNetUpdateFrequency) {};
+
+	// Players further away than this don't get the pickup replicated to them
+	UPROPERTY(EditAnywhere, Category = "Replication")
+	float NetCullDistance;
+
+	// How often the pickup is checked for changes while it's awake, and how low adaptive net update frequency can take that when nothing changes
+	UPROPERTY(EditAnywhere, Category = "Replication")
+	float NetUpdateFrequency;
+
+	UPROPERTY(EditAnywhere, Category = "Replication")
+	float MinNetUpdateFrequency;
+};
+
+// Where a dropped pickup came to rest
+USTRUCT()
+struct FPickupPlacement
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FVector_NetQuantize Location;
+
+	UPROPERTY()
+	FRotator Rotation;
+};
+
 UCLASS()
 class SURVIVALGAME_API APickup : public AActor
 {
 	GENERATED_BODY()
 
+	friend class UPickupPoolSubsystem;
+	friend class UPickupCleanupSubsystem;
+	friend class UPickupPlacementSubsystem;
+
 public:
 	// Sets default values for this actor's properties
 	APickup();
@@ -18,31 +124,147 @@ public:
 	// Takes the item to represent and creates the pickup from it. Done on BeginPlay and when a player drops an item on the ground.
 	void InitializePickup(const TSubclassOf<class UItem> ItemClass, const int32 Quantity);
 
-	/** Align pickups rotation with ground rotation*/
+	/** Same as above, but only remembers the item class and quantity. The item itself isn't created until something needs it, usually a player
+	taking the pickup. Clients never need it, so most map placed loot never creates one */
+	void InitializePickupLazily(const TSubclassOf<class UItem> ItemClass, const int32 Quantity);
+
+	// Same as above, for callers that only have the catalog ID of the item, ie loot tables and save games
+	void InitializePickup(const FItemId ItemId, const int32 Quantity);
+
+	// Creates the pickup from an existing item, taking ownership of it instead of creating a new one. Used when a player drops a whole stack.
+	void InitializePickupWithItem(class UItem* InItem);
+
+	/** [Server] Add to our stack, up to the item's max stack size. Returns how much was actually added. Used to merge drops into us */
+	int32 AddToStack(const int32 Amount);
+
+	/** Align pickups rotation with ground rotation. Only called when bAlignWithGroundNatively is off */
 	UFUNCTION(BlueprintImplementableEvent)
 		void AlignWithGround();
 
+	// [Server] Our item, or null if it hasn't been created yet. See EnsureItem()
+	FORCEINLINE class UItem* GetItem() const { return Item; };
+
+	/** [Server] Our item, creating it first if we were set up lazily. Use this rather than GetItem() before handing the item to anything */
+	class UItem* EnsureItem();
+
+	/** The item class defaults of what this pickup holds, for showing it. Works on clients, which don't have the item itself */
+	UFUNCTION(BlueprintPure, Category = "Pickup")
+		class UItem* GetItemDefaults() const;
+
+	UFUNCTION(BlueprintPure, Category = "Pickup")
+		FORCEINLINE int32 GetQuantity() const { return PickupState.Quantity; };
+
+	FORCEINLINE FItemId GetItemId() const { return PickupState.ItemId; };
+
+	/** [Server] Called by UPickupPoolSubsystem when it hands this pickup out again, or takes it back. A pooled pickup has no item, so it
+	has no mesh and can't be interacted with, and is dormant so it costs nothing to replicate until it's reused */
+	void OnAcquiredFromPool(const FTransform& Transform);
+	void OnReleasedToPool();
+
+	FORCEINLINE bool IsPooled() const { return bPooled; };
+
 	// This is used as a template to create the pickup when spawned in
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Instanced)
 		class UItem* ItemTemplate;
 
 protected:
-	// The item that will be added to the inventory when this pickup is take
-	UPROPERTY(BlueprintReadWrite, VisibleAnywhere, ReplicatedUsing = OnRep_Item)
+	// [Server] The item that will be added to the inventory when this pickup is taken. Clients only get PickupState
+	UPROPERTY(BlueprintReadWrite, VisibleAnywhere)
 		class UItem* Item;
 
+	// [Server] What to create our item from, if we were set up with InitializePickupLazily() and nothing has needed the item yet
+	UPROPERTY()
+		TSubclassOf<class UItem> LazyItemClass;
+
+	int32 LazyQuantity;
+
+	/** Whether map placed pickups wait until they're needed before creating their item. Saves an item object per pickup,
+	and creating them all when the map loads */
+	UPROPERTY(EditDefaultsOnly, Category = "Pickup")
+		bool bCreateItemLazily;
+
+	// What our item is and how many of it there are, for clients to show. Kept up to date by UpdatePickupState()
+	UPROPERTY(ReplicatedUsing = OnRep_PickupState)
+		FPickupReplicatedState PickupState;
+
 	UFUNCTION()
-		void OnRep_Item();
+		void OnRep_PickupState();
+
+	// [Server] Copy our item into PickupState. Call after setting Item or changing its quantity
+	void UpdatePickupState();
+
+	// Whether we came from UPickupPoolSubsystem, and so go back to it instead of being destroyed
+	bool bFromPool;
+
+	// [Server] Whether we're in the pool right now
+	bool bPooled;
+
+	// [Server] Changes every time the pool reuses us, so anything keeping track of a drop can tell it apart from a later one
+	uint8 ReuseCount;
+
+	// [Server] The cell UPickupPoolSubsystem filed us under for merging drops, which can be a different one from where we are now
+	FIntVector DropCell;
+	uint8 bFiledAsDrop : 1;
+
+	/** [Server] How UPickupCleanupSubsystem is tracking us: which of its entries is the current one, the region it counts us in,
+	and when we were last dropped or merged into */
+	int32 CleanupTrackId;
+	FIntVector CleanupRegion;
+	float CleanupDropTime;
+	uint8 bCleanupTracked : 1;
+
+	/** Where we ended up once placed on the ground, or where the pool last put us. Pickups don't replicate movement,
+	so this is how clients learn about a reused pickup's new location, and where physics settled a drop */
+	UPROPERTY(ReplicatedUsing = OnRep_Placement)
+		FPickupPlacement Placement;
 
-	/** If some property on the item is modified, we bind this to OnItemModified and refresh the UI if the item gets modified. */
 	UFUNCTION()
-		void OnItemModified();
+		void OnRep_Placement();
+
+	/** Whether dropped pickups are placed on the ground by UPickupPlacementSubsystem on the server, rather than every machine calling
+	AlignWithGround(). Turn off for pickups whose Blueprint does its own placement */
+	UPROPERTY(EditDefaultsOnly, Category = "Pickup")
+		bool bAlignWithGroundNatively;
+
+	/** Whether dropped pickups fall and come to rest with physics after being placed, for pickups that shouldn't sit flat on the ground.
+	Only simulated on the server, and only until the pickup stops moving or MaxSettleTime runs out */
+	UPROPERTY(EditDefaultsOnly, Category = "Pickup", meta = (EditCondition = "bAlignWithGroundNatively"))
+		bool bSettleWithPhysics;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Pickup", meta = (EditCondition = "bSettleWithPhysics", ClampMin = 0.0))
+		float MaxSettleTime;
+
+	// [Server] Whether we're waiting for UPickupPlacementSubsystem to place us, so we're only queued once
+	uint8 bPlacementQueued : 1;
+
+	// [Server] Move onto the ground the subsystem found under us, facing the same way
+	void PlaceOnGround(const FHitResult& GroundHit);
+
+	// [Server] Start simulating physics so we can come to rest. Returns false if there's nothing to simulate
+	bool StartSettling();
+
+	// [Server] Stop simulating and send where we ended up. After this we cost nothing until our item changes or we're taken
+	void FinishPlacement();
+
+	// Place ourselves on the ground, either natively or with AlignWithGround(). Called when we're dropped or reused
+	void RequestPlacement();
+
+	// Go back to the pool if we came from it, otherwise destroy ourselves
+	void DestroyOrRelease();
+
+	/** Net cull distance and update frequency for each item rarity. Pickups are dormant almost all the time, so these only matter
+	for the first replication to a player and while a pickup's item is changing */
+	UPROPERTY(EditDefaultsOnly, Category = "Replication")
+		TMap<EItemRarity, FPickupNetSettings> NetSettingsByRarity;
+
+	// [Server] Use the net settings for our item's rarity
+	void ApplyNetSettings();
 
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
-	virtual bool ReplicateSubobjects(class UActorChannel* Channel, class FOutBunch* Bunch, FReplicationFlags* RepFlags) override;
 
 #if WITH_EDITOR
 	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
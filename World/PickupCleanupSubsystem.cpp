@@ -0,0 +1,345 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "World/PickupCleanupSubsystem.h"
+#include "World/Pickup.h"
+#include "World/PickupManager.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/Pawn.h"
+#include "HAL/IConsoleManager.h"
+
+UPickupCleanupSubsystem::UPickupCleanupSubsystem()
+{
+	MaxAge = 1800.f;
+	RegionSize = 2000.f;
+	MaxPickupsPerRegion = 48;
+	ProtectDistance = 1500.f;
+	CleanupInterval = 5.f;
+	MaxMillisecondsPerFrame = 0.25f;
+
+	PassIndex = INDEX_NONE;
+	NextPassTime = 0.f;
+	NumRemovedInPass = 0;
+
+	NumPasses = 0;
+	NumDespawned = 0;
+	NumCompacted = 0;
+	NumCompactFailed = 0;
+	CleanupSeconds = 0.0;
+	MaxFrameSeconds = 0.0;
+	NumCleanupFrames = 0;
+}
+
+void UPickupCleanupSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &UPickupCleanupSubsystem::OnWorldPostActorTick);
+}
+
+void UPickupCleanupSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+	TrackedPickups.Empty();
+	RegionCounts.Empty();
+	NumRemovedInPass = 0;
+
+	Super::Deinitialize();
+}
+
+UPickupCleanupSubsystem* UPickupCleanupSubsystem::Get(const UObject* WorldContextObject)
+{
+	if (UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr)
+	{
+		return World->GetSubsystem<UPickupCleanupSubsystem>();
+	}
+	return nullptr;
+}
+
+void UPickupCleanupSubsystem::TrackPickup(class APickup* Pickup)
+{
+	if (!Pickup || Pickup->bNetStartup || !Pickup->HasAuthority())
+	{
+		return;
+	}
+
+	TrackPickupAt(Pickup, GetWorld()->GetTimeSeconds());
+}
+
+void UPickupCleanupSubsystem::RefreshPickup(class APickup* Pickup)
+{
+	if (Pickup && Pickup->bCleanupTracked)
+	{
+		TrackPickupAt(Pickup, GetWorld()->GetTimeSeconds());
+	}
+}
+
+void UPickupCleanupSubsystem::UpdatePickup(class APickup* Pickup)
+{
+	// Keeps the drop time, so the new entry can sit slightly out of order. Placement finishes within MaxSettleTime of the drop, so never by much
+	if (Pickup && Pickup->bCleanupTracked && Pickup->CleanupRegion != GetRegion(Pickup->GetActorLocation()))
+	{
+		TrackPickupAt(Pickup, Pickup->CleanupDropTime);
+	}
+}
+
+void UPickupCleanupSubsystem::TrackPickupAt(class APickup* Pickup, const float DropTime)
+{
+	// The old entry stays in TrackedPickups until a pass finds it's been replaced, but stops counting towards its region now
+	if (Pickup->bCleanupTracked)
+	{
+		if (int32* RegionCount = RegionCounts.Find(Pickup->CleanupRegion))
+		{
+			if (--(*RegionCount) <= 0)
+			{
+				RegionCounts.Remove(Pickup->CleanupRegion);
+			}
+		}
+	}
+
+	FTrackedPickup& Tracked = TrackedPickups.AddDefaulted_GetRef();
+	Tracked.Pickup = Pickup;
+	Tracked.TrackId = ++Pickup->CleanupTrackId;
+	Tracked.Region = GetRegion(Pickup->GetActorLocation());
+	Tracked.DropTime = DropTime;
+	Tracked.bRemoved = false;
+
+	Pickup->CleanupRegion = Tracked.Region;
+	Pickup->CleanupDropTime = DropTime;
+	Pickup->bCleanupTracked = true;
+
+	RegionCounts.FindOrAdd(Tracked.Region)++;
+}
+
+void UPickupCleanupSubsystem::RequestCleanup()
+{
+	NextPassTime = 0.f;
+}
+
+FIntVector UPickupCleanupSubsystem::GetRegion(const FVector& Location) const
+{
+	const float Size = FMath::Max(RegionSize, 1.f);
+	return FIntVector(FMath::FloorToInt(Location.X / Size), FMath::FloorToInt(Location.Y / Size), FMath::FloorToInt(Location.Z / Size));
+}
+
+bool UPickupCleanupSubsystem::IsStale(const FTrackedPickup& Tracked) const
+{
+	const APickup* Pickup = Tracked.Pickup.Get();
+	return !Pickup || Pickup->IsPendingKillPending() || Pickup->IsPooled() || Pickup->CleanupTrackId != Tracked.TrackId;
+}
+
+bool UPickupCleanupSubsystem::ShouldCleanUp(const FTrackedPickup& Tracked, const TArray<FVector>& PlayerLocations, bool& bOutCompact) const
+{
+	const APickup* Pickup = Tracked.Pickup.Get();
+	const FVector PickupLocation = Pickup->GetActorLocation();
+	const float ProtectDistanceSquared = FMath::Square(ProtectDistance);
+
+	for (const FVector& PlayerLocation : PlayerLocations)
+	{
+		if (FVector::DistSquared(PlayerLocation, PickupLocation) <= ProtectDistanceSquared)
+		{
+			return false;
+		}
+	}
+
+	if (MaxAge > 0.f && GetWorld()->TimeSince(Tracked.DropTime) > MaxAge)
+	{
+		bOutCompact = false;
+		return true;
+	}
+
+	// We go oldest first, so the pickups compacted out of a crowded region are its oldest ones. Records only hold catalog IDs,
+	// so items that aren't in the catalog stay as actors rather than being despawned for crowding
+	if (MaxPickupsPerRegion > 0 && RegionCounts.FindRef(Tracked.Region) > MaxPickupsPerRegion && Pickup->GetItemId().IsValid())
+	{
+		bOutCompact = true;
+		return true;
+	}
+
+	return false;
+}
+
+void UPickupCleanupSubsystem::CleanUp(class APickup* Pickup, const bool bCompact)
+{
+	if (bCompact)
+	{
+		// Records only hold the catalog ID and quantity, which is all an item lying on the ground has
+		APickupManager* Manager = APickupManager::Get(this);
+
+		if (Manager && Manager->AddPickup(Pickup->GetItemId(), Pickup->GetQuantity(), Pickup->GetActorTransform()) != INDEX_NONE)
+		{
+			++NumCompacted;
+		}
+		else
+		{
+			// The region is still over its limit, so the pickup goes either way
+			++NumCompactFailed;
+			++NumDespawned;
+		}
+	}
+	else
+	{
+		++NumDespawned;
+	}
+
+	Pickup->DestroyOrRelease();
+}
+
+void UPickupCleanupSubsystem::RemoveTrackedAt(const int32 Index)
+{
+	FTrackedPickup& Tracked = TrackedPickups[Index];
+	APickup* Pickup = Tracked.Pickup.Get();
+
+	// Entries that have been replaced by a newer one no longer count towards their region
+	if (!Pickup || Pickup->CleanupTrackId == Tracked.TrackId)
+	{
+		const FIntVector Region = Tracked.Region;
+
+		if (int32* RegionCount = RegionCounts.Find(Region))
+		{
+			if (--(*RegionCount) <= 0)
+			{
+				RegionCounts.Remove(Region);
+			}
+		}
+
+		if (Pickup)
+		{
+			Pickup->bCleanupTracked = false;
+		}
+	}
+
+	// Removing from the middle shifts everything after it, which adds up over a pass that removes thousands, so mark it and compact at the end
+	Tracked.Pickup.Reset();
+	Tracked.bRemoved = true;
+	++NumRemovedInPass;
+}
+
+void UPickupCleanupSubsystem::CompactTracked()
+{
+	if (NumRemovedInPass > 0)
+	{
+		// RemoveAll keeps the order of what's left, so TrackedPickups stays oldest first
+		TrackedPickups.RemoveAll([](const FTrackedPickup& Tracked) { return Tracked.bRemoved; });
+		NumRemovedInPass = 0;
+	}
+
+	TrackedPickups.Shrink();
+}
+
+void UPickupCleanupSubsystem::OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World != GetWorld() || World->IsNetMode(NM_Client) || TickType == LEVELTICK_TimeOnly)
+	{
+		return;
+	}
+
+	if (PassIndex == INDEX_NONE && TrackedPickups.Num() && World->GetTimeSeconds() >= NextPassTime)
+	{
+		PassIndex = 0;
+		NextPassTime = World->GetTimeSeconds() + CleanupInterval;
+		++NumPasses;
+	}
+
+	if (PassIndex != INDEX_NONE)
+	{
+		RunCleanupSlice();
+	}
+}
+
+void UPickupCleanupSubsystem::RunCleanupSlice()
+{
+	const double StartSeconds = FPlatformTime::Seconds();
+	const double EndSeconds = StartSeconds + MaxMillisecondsPerFrame / 1000.0;
+
+	TArray<FVector> PlayerLocations;
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		if (const APawn* Pawn = It->Get() ? It->Get()->GetPawn() : nullptr)
+		{
+			PlayerLocations.Add(Pawn->GetActorLocation());
+		}
+	}
+
+	int32 NumVisited = 0;
+
+	while (PassIndex < TrackedPickups.Num())
+	{
+		// Checking the clock costs something too, so only do it every few pickups and after anything expensive
+		if ((++NumVisited & 15) == 0 && FPlatformTime::Seconds() >= EndSeconds)
+		{
+			break;
+		}
+
+		const FTrackedPickup& Tracked = TrackedPickups[PassIndex];
+		bool bCompact = false;
+
+		if (IsStale(Tracked))
+		{
+			RemoveTrackedAt(PassIndex++);
+		}
+		else if (ShouldCleanUp(Tracked, PlayerLocations, bCompact))
+		{
+			APickup* Pickup = Tracked.Pickup.Get();
+			RemoveTrackedAt(PassIndex++);
+			CleanUp(Pickup, bCompact);
+
+			if (FPlatformTime::Seconds() >= EndSeconds)
+			{
+				break;
+			}
+		}
+		else
+		{
+			++PassIndex;
+		}
+	}
+
+	if (PassIndex >= TrackedPickups.Num())
+	{
+		PassIndex = INDEX_NONE;
+		CompactTracked();
+	}
+
+	const double FrameSeconds = FPlatformTime::Seconds() - StartSeconds;
+
+	CleanupSeconds += FrameSeconds;
+	MaxFrameSeconds = FMath::Max(MaxFrameSeconds, FrameSeconds);
+	++NumCleanupFrames;
+}
+
+#if !UE_BUILD_SHIPPING
+static FAutoConsoleCommandWithWorldAndArgs PickupCleanupStatsCommand(
+	TEXT("SurvivalGame.Pickups.CleanupStats"),
+	TEXT("Logs how many dropped pickups are tracked for cleanup, how many were despawned or compacted, and how long cleanup took per frame. Usage: SurvivalGame.Pickups.CleanupStats [reset|run]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UPickupCleanupSubsystem* Cleanup = World ? World->GetSubsystem<UPickupCleanupSubsystem>() : nullptr;
+
+		if (!Cleanup)
+		{
+			return;
+		}
+
+		if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+		{
+			Cleanup->NumPasses = Cleanup->NumDespawned = Cleanup->NumCompacted = Cleanup->NumCompactFailed = Cleanup->NumCleanupFrames = 0;
+			Cleanup->CleanupSeconds = Cleanup->MaxFrameSeconds = 0.0;
+			return;
+		}
+
+		if (Args.Num() > 0 && Args[0] == TEXT("run"))
+		{
+			Cleanup->RequestCleanup();
+			return;
+		}
+
+		const int32 NumCleanupFrames = FMath::Max(Cleanup->NumCleanupFrames, 1);
+
+		UE_LOG(LogTemp, Log, TEXT("Pickup cleanup: %d pickups tracked in %d regions. %d passes, %d despawned, %d compacted into records (%d couldn't be and were despawned). %.3f ms average, %.3f ms worst over %d frames"),
+			Cleanup->GetNumTracked(), Cleanup->GetNumRegions(), Cleanup->NumPasses, Cleanup->NumDespawned, Cleanup->NumCompacted, Cleanup->NumCompactFailed,
+			Cleanup->CleanupSeconds * 1000.0 / NumCleanupFrames, Cleanup->MaxFrameSeconds * 1000.0, Cleanup->NumCleanupFrames);
+	}));
+#endif
@@ -0,0 +1,134 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "PickupCleanupSubsystem.generated.h"
+
+/**
+ * [Server] Keeps the number of dropped pickups in check on long running servers. Every pickup handed out by UPickupPoolSubsystem is
+ * tracked oldest first, and a cleanup pass walks them a slice at a time, never spending more than MaxMillisecondsPerFrame in a frame.
+ * Pickups older than MaxAge are despawned, and the oldest pickups in a region holding more than MaxPickupsPerRegion are compacted into
+ * APickupManager records, which players can still pick up. Pickups with a player nearby are left alone, as are pickups placed in the map.
+ */
+UCLASS(Config = Game)
+class SURVIVALGAME_API UPickupCleanupSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	UPickupCleanupSubsystem();
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/** Get the pickup cleanup subsystem for the world the given object is in */
+	static UPickupCleanupSubsystem* Get(const UObject* WorldContextObject);
+
+	/** [Server] Start tracking a dropped pickup. Called by UPickupPoolSubsystem whenever it hands one out. Pickups placed in the map are ignored */
+	void TrackPickup(class APickup* Pickup);
+
+	/** [Server] Start a tracked pickup's age again, because a drop was merged into it. Otherwise a fresh drop merged into an old stack
+	would be despawned along with it */
+	void RefreshPickup(class APickup* Pickup);
+
+	/** [Server] Count a tracked pickup in the region it's in now, after it was placed on the ground or settled somewhere else */
+	void UpdatePickup(class APickup* Pickup);
+
+	/** Start a cleanup pass on the next frame rather than waiting for CleanupInterval */
+	void RequestCleanup();
+
+	FORCEINLINE int32 GetNumTracked() const { return TrackedPickups.Num() - NumRemovedInPass; };
+	FORCEINLINE int32 GetNumRegions() const { return RegionCounts.Num(); };
+
+	// How many passes were run, how many pickups they despawned for being too old or compacted for being in a crowded region,
+	// and how many of those they had to despawn because they couldn't be compacted
+	int32 NumPasses;
+	int32 NumDespawned;
+	int32 NumCompacted;
+	int32 NumCompactFailed;
+
+	// Time spent cleaning up in total and in the slowest frame, in seconds, and how many frames did any cleanup
+	double CleanupSeconds;
+	double MaxFrameSeconds;
+	int32 NumCleanupFrames;
+
+protected:
+
+	// Dropped pickups older than this many seconds are despawned. 0 never despawns pickups for their age
+	UPROPERTY(Config)
+	float MaxAge;
+
+	// The size of the regions MaxPickupsPerRegion counts pickups in
+	UPROPERTY(Config)
+	float RegionSize;
+
+	// The most dropped pickup actors a region can have. The oldest ones above this are compacted. 0 for no limit
+	UPROPERTY(Config)
+	int32 MaxPickupsPerRegion;
+
+	// Pickups within this distance of a player are never cleaned up. Should be more than APickupManager's DemoteDistance,
+	// otherwise compacted pickups are promoted straight back
+	UPROPERTY(Config)
+	float ProtectDistance;
+
+	// Seconds between the start of one cleanup pass and the next
+	UPROPERTY(Config)
+	float CleanupInterval;
+
+	// The most time a pass can take in any one frame. The rest of the pass carries on next frame
+	UPROPERTY(Config)
+	float MaxMillisecondsPerFrame;
+
+private:
+
+	struct FTrackedPickup
+	{
+		TWeakObjectPtr<class APickup> Pickup;
+
+		/** The pickup's CleanupTrackId when this entry was made. A pickup that's reused, merged into or moved gets a new entry, and this
+		tells the old one apart. The region count has already moved to the new entry, so old entries are dropped without touching it */
+		int32 TrackId;
+
+		FIntVector Region;
+		float DropTime;
+
+		// Removed during the current pass. Removed entries stay in TrackedPickups until the pass ends
+		bool bRemoved;
+	};
+
+	// Oldest first, so a pass reaches the pickups that should go first before the rest
+	TArray<FTrackedPickup> TrackedPickups;
+
+	// How many entries the current pass has removed. They're compacted out of TrackedPickups in one go when it ends
+	int32 NumRemovedInPass;
+
+	// How many tracked pickups are in each region
+	TMap<FIntVector, int32> RegionCounts;
+
+	// Where the current pass is in TrackedPickups, or INDEX_NONE between passes
+	int32 PassIndex;
+	float NextPassTime;
+
+	FDelegateHandle PostActorTickHandle;
+
+	FIntVector GetRegion(const FVector& Location) const;
+
+	// Add an entry for the pickup, replacing any it already has
+	void TrackPickupAt(class APickup* Pickup, const float DropTime);
+
+	// Whether a tracked pickup is gone, pooled or reused for a newer drop, and so shouldn't be tracked any more
+	bool IsStale(const FTrackedPickup& Tracked) const;
+
+	// True if the pickup should be cleaned up, along with whether to compact it rather than despawn it
+	bool ShouldCleanUp(const FTrackedPickup& Tracked, const TArray<FVector>& PlayerLocations, bool& bOutCompact) const;
+
+	void CleanUp(class APickup* Pickup, const bool bCompact);
+	void RemoveTrackedAt(const int32 Index);
+	void CompactTracked();
+
+	void OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+	void RunCleanupSlice();
+};
@@ -0,0 +1,848 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "World/PickupManager.h"
+#include "World/Pickup.h"
+#include "Items/Item.h"
+#include "Items/ItemCatalog.h"
+#include "Items/ItemDefinition.h"
+#include "Framework/SurvivalGameStateBase.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/Pawn.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "TimerManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Net/UnrealNetwork.h"
+
+APickupManager::APickupManager()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	SetRootComponent(CreateDefaultSubobject<USceneComponent>("Root"));
+
+	// Clients need a manager to draw the records their cells bring in, but the records themselves replicate through the cells
+	SetReplicates(true);
+	bAlwaysRelevant = true;
+	NetUpdateFrequency = 1.f;
+
+	PickupClass = APickup::StaticClass();
+	PromoteDistance = 600.f;
+	DemoteDistance = 900.f;
+	PromotionInterval = 0.25f;
+	CellSize = 600.f;
+	NetCellSize = 5000.f;
+	NetCullDistance = 15000.f;
+	MaxRecordsPerNetCell = 1000;
+	InstanceCullDistance = 0;
+
+	NextRecordId = 0;
+}
+
+APickupManager* APickupManager::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	ASurvivalGameStateBase* GameState = World ? World->GetGameState<ASurvivalGameStateBase>() : nullptr;
+
+	if (!GameState)
+	{
+		return nullptr;
+	}
+
+	if (!GameState->PickupManager && GameState->HasAuthority())
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+		GameState->PickupManager = World->SpawnActor<APickupManager>(APickupManager::StaticClass(), FTransform::Identity, SpawnParams);
+	}
+
+	return GameState->PickupManager;
+}
+
+void APickupManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Clients find us through the game state too
+	if (ASurvivalGameStateBase* GameState = GetWorld()->GetGameState<ASurvivalGameStateBase>())
+	{
+		GameState->PickupManager = this;
+	}
+
+	if (HasAuthority())
+	{
+		GetWorldTimerManager().SetTimer(TimerHandle_UpdatePromotions, this, &APickupManager::UpdatePromotions, PromotionInterval, true);
+	}
+	else
+	{
+		// Cells that arrived before we did had nobody to draw their records
+		for (TActorIterator<APickupRecordCell> It(GetWorld()); It; ++It)
+		{
+			It->AddRecordsToManager();
+		}
+	}
+}
+
+void APickupManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	GetWorldTimerManager().ClearTimer(TimerHandle_UpdatePromotions);
+
+	// The cells only mean anything to us
+	if (HasAuthority() && EndPlayReason == EEndPlayReason::Destroyed)
+	{
+		for (APickupRecordCell* NetCell : RecordCellActors)
+		{
+			if (NetCell)
+			{
+				NetCell->Destroy();
+			}
+		}
+	}
+
+	ASurvivalGameStateBase* GameState = GetWorld()->GetGameState<ASurvivalGameStateBase>();
+
+	if (GameState && GameState->PickupManager == this)
+	{
+		GameState->PickupManager = nullptr;
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+
+int32 APickupManager::AddPickup(const FItemId ItemId, const int32 Quantity, const FTransform& Transform)
+{
+	const UItemCatalog* Catalog = UItemCatalog::Get(this);
+
+	if (!HasAuthority() || Quantity <= 0 || !Catalog || !Catalog->GetItemClass(ItemId))
+	{
+		return INDEX_NONE;
+	}
+
+	APickupRecordCell* NetCell = FindOrAddNetCell(Transform.GetLocation());
+
+	if (!NetCell)
+	{
+		return INDEX_NONE;
+	}
+
+	FPickupRecord& Record = NetCell->AddRecord(NextRecordId++);
+	Record.ItemId = ItemId;
+	Record.Quantity = Quantity;
+	Record.Location = Transform.GetLocation();
+	Record.Rotation = Transform.Rotator();
+	Record.Yaw = FRotator::CompressAxisToByte(Record.Rotation.Yaw);
+
+	CellByRecordId.Add(Record.RecordId, NetCell);
+	RecordCells.FindOrAdd(GetCell(Record.Location)).Add(Record.RecordId);
+
+	NetCell->MarkRecordDirty(Record);
+	OnRecordAdded(Record);
+
+	return Record.RecordId;
+}
+
+void APickupManager::RemovePickup(const int32 RecordId)
+{
+	if (!HasAuthority() || !CellByRecordId.Contains(RecordId))
+	{
+		return;
+	}
+
+	if (APickup* Pickup = PromotedPickups.FindRef(RecordId))
+	{
+		Pickup->OnDestroyed.RemoveDynamic(this, &APickupManager::OnPromotedPickupDestroyed);
+		Pickup->Destroy();
+	}
+
+	PromotedPickups.Remove(RecordId);
+	RemoveRecord(RecordId);
+}
+
+void APickupManager::RemoveAllPickups()
+{
+	if (!HasAuthority())
+	{
+		return;
+	}
+
+	TArray<int32> RecordIds;
+	CellByRecordId.GetKeys(RecordIds);
+
+	for (const int32 RecordId : RecordIds)
+	{
+		RemovePickup(RecordId);
+	}
+}
+
+void APickupManager::RemoveRecord(const int32 RecordId)
+{
+	APickupRecordCell* NetCell = CellByRecordId.FindRef(RecordId);
+	FPickupRecord* Record = NetCell ? NetCell->FindRecord(RecordId) : nullptr;
+
+	if (!Record)
+	{
+		return;
+	}
+
+	OnRecordRemoved(*Record);
+
+	const FIntVector Cell = GetCell(Record->Location);
+
+	if (TArray<int32>* CellRecords = RecordCells.Find(Cell))
+	{
+		CellRecords->RemoveSingleSwap(RecordId, false);
+
+		if (CellRecords->Num() == 0)
+		{
+			RecordCells.Remove(Cell);
+		}
+	}
+
+	CellByRecordId.Remove(RecordId);
+	NetCell->RemoveRecord(RecordId);
+}
+
+APickupRecordCell* APickupManager::FindOrAddNetCell(const FVector& Location)
+{
+	const float Size = FMath::Max(NetCellSize, 1.f);
+	const FIntPoint Key(FMath::FloorToInt(Location.X / Size), FMath::FloorToInt(Location.Y / Size));
+	TArray<APickupRecordCell*>& Cells = NetCells.FindOrAdd(Key);
+
+	for (APickupRecordCell* NetCell : Cells)
+	{
+		if (NetCell->GetNumRecords() < MaxRecordsPerNetCell)
+		{
+			return NetCell;
+		}
+	}
+
+	// Relevancy is measured from the middle of the square, so the cull distance has to reach its corners as well
+	const FVector Centre((Key.X + 0.5f) * Size, (Key.Y + 0.5f) * Size, Location.Z);
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.Owner = this;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	APickupRecordCell* NetCell = GetWorld()->SpawnActor<APickupRecordCell>(APickupRecordCell::StaticClass(), FTransform(Centre), SpawnParams);
+
+	if (NetCell)
+	{
+		NetCell->NetCullDistanceSquared = FMath::Square(NetCullDistance + Size * HALF_SQRT_2);
+		Cells.Add(NetCell);
+		RecordCellActors.Add(NetCell);
+	}
+
+	return NetCell;
+}
+
+void APickupManager::MarkRecordDirty(FPickupRecord& Record)
+{
+	if (APickupRecordCell* NetCell = CellByRecordId.FindRef(Record.RecordId))
+	{
+		NetCell->MarkRecordDirty(Record);
+	}
+}
+
+FIntVector APickupManager::GetCell(const FVector& Location) const
+{
+	return FIntVector(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize), FMath::FloorToInt(Location.Z / CellSize));
+}
+
+FPickupRecord* APickupManager::FindRecord(const int32 RecordId)
+{
+	APickupRecordCell* NetCell = CellByRecordId.FindRef(RecordId);
+	return NetCell ? NetCell->FindRecord(RecordId) : nullptr;
+}
+
+void APickupManager::UpdatePromotions()
+{
+	TArray<FVector, TInlineAllocator<16>> PlayerLocations;
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PC = It->Get();
+
+		if (const APawn* Pawn = PC ? PC->GetPawn() : nullptr)
+		{
+			PlayerLocations.Add(Pawn->GetActorLocation());
+		}
+	}
+
+	// Demote first, so pickups nobody is near any more are gone before we spawn new ones
+	TArray<int32, TInlineAllocator<16>> RecordsToDemote;
+	const float DemoteDistanceSquared = FMath::Square(DemoteDistance);
+
+	for (const TPair<int32, APickup*>& Promoted : PromotedPickups)
+	{
+		const FVector PickupLocation = Promoted.Value ? Promoted.Value->GetActorLocation() : FVector::ZeroVector;
+
+		const bool bPlayerNearby = PlayerLocations.ContainsByPredicate([&PickupLocation, DemoteDistanceSquared](const FVector& PlayerLocation)
+		{
+			return FVector::DistSquared(PlayerLocation, PickupLocation) <= DemoteDistanceSquared;
+		});
+
+		if (!bPlayerNearby)
+		{
+			RecordsToDemote.Add(Promoted.Key);
+		}
+	}
+
+	for (const int32 RecordId : RecordsToDemote)
+	{
+		if (FPickupRecord* Record = FindRecord(RecordId))
+		{
+			DemoteRecord(*Record);
+		}
+	}
+
+	const float PromoteDistanceSquared = FMath::Square(PromoteDistance);
+
+	for (const FVector& PlayerLocation : PlayerLocations)
+	{
+		const FIntVector MinCell = GetCell(PlayerLocation - FVector(PromoteDistance));
+		const FIntVector MaxCell = GetCell(PlayerLocation + FVector(PromoteDistance));
+
+		for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+		{
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+			{
+				for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z)
+				{
+					const TArray<int32>* CellRecords = RecordCells.Find(FIntVector(X, Y, Z));
+
+					if (!CellRecords)
+					{
+						continue;
+					}
+
+					for (const int32 RecordId : *CellRecords)
+					{
+						FPickupRecord* Record = FindRecord(RecordId);
+
+						if (Record && !Record->bPromoted && FVector::DistSquared(PlayerLocation, Record->Location) <= PromoteDistanceSquared)
+						{
+							PromoteRecord(*Record);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void APickupManager::PromoteRecord(FPickupRecord& Record)
+{
+	const FTransform Transform = Record.GetTransform();
+	APickup* Pickup = GetWorld()->SpawnActorDeferred<APickup>(PickupClass, Transform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+
+	if (!Pickup)
+	{
+		return;
+	}
+
+	// Set up before it finishes spawning, so clients get it complete in one bunch. Most promoted pickups are walked past rather than taken, so don't create the item until it's needed
+	const UItemCatalog* Catalog = UItemCatalog::Get(this);
+	Pickup->InitializePickupLazily(Catalog ? Catalog->GetItemClass(Record.ItemId) : nullptr, Record.Quantity);
+	Pickup->FinishSpawning(Transform);
+	Pickup->OnDestroyed.AddDynamic(this, &APickupManager::OnPromotedPickupDestroyed);
+
+	PromotedPickups.Add(Record.RecordId, Pickup);
+
+	Record.bPromoted = true;
+	MarkRecordDirty(Record);
+	OnRecordChanged(Record);
+}
+
+void APickupManager::DemoteRecord(FPickupRecord& Record)
+{
+	if (APickup* Pickup = PromotedPickups.FindRef(Record.RecordId))
+	{
+		// Players may have taken part of the stack while it was promoted
+		if (Pickup->GetQuantity() > 0)
+		{
+			Record.Quantity = Pickup->GetQuantity();
+		}
+
+		Pickup->OnDestroyed.RemoveDynamic(this, &APickupManager::OnPromotedPickupDestroyed);
+		Pickup->Destroy();
+	}
+
+	PromotedPickups.Remove(Record.RecordId);
+
+	Record.bPromoted = false;
+	MarkRecordDirty(Record);
+	OnRecordChanged(Record);
+}
+
+void APickupManager::OnPromotedPickupDestroyed(AActor* DestroyedActor)
+{
+	if (IsActorBeingDestroyed())
+	{
+		return;
+	}
+
+	if (const int32* RecordId = PromotedPickups.FindKey(Cast<APickup>(DestroyedActor)))
+	{
+		const int32 TakenRecordId = *RecordId;
+
+		PromotedPickups.Remove(TakenRecordId);
+		RemoveRecord(TakenRecordId);
+	}
+}
+
+void APickupManager::OnRecordAdded(FPickupRecord& Record)
+{
+	if (!Record.bPromoted)
+	{
+		AddInstance(Record);
+	}
+}
+
+void APickupManager::OnRecordChanged(FPickupRecord& Record)
+{
+	if (Record.bPromoted)
+	{
+		RemoveInstance(Record);
+	}
+	else
+	{
+		AddInstance(Record);
+	}
+}
+
+void APickupManager::OnRecordRemoved(FPickupRecord& Record)
+{
+	RemoveInstance(Record);
+}
+
+void APickupManager::AddInstance(FPickupRecord& Record)
+{
+	// Nothing is drawn on a dedicated server
+	if (Record.InstanceIndex != INDEX_NONE || GetNetMode() == NM_DedicatedServer)
+	{
+		return;
+	}
+
+	const UItemCatalog* Catalog = UItemCatalog::Get(this);
+	const UItemDefinition* Definition = Catalog ? Catalog->GetItemDefinition(Record.ItemId) : nullptr;
+	UStaticMesh* Mesh = Definition ? Definition->PickUpMesh : nullptr;
+
+	if (!Mesh)
+	{
+		return;
+	}
+
+	FPickupMeshInstances* Instances = MeshInstances.Find(Mesh);
+
+	if (!Instances)
+	{
+		UHierarchicalInstancedStaticMeshComponent* Component = NewObject<UHierarchicalInstancedStaticMeshComponent>(this, NAME_None, RF_Transient);
+		Component->SetStaticMesh(Mesh);
+		Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		Component->SetCanEverAffectNavigation(false);
+		Component->SetCullDistances(0, InstanceCullDistance);
+		Component->SetupAttachment(GetRootComponent());
+		Component->RegisterComponent();
+
+		Instances = &MeshInstances.Add(Mesh);
+		Instances->Component = Component;
+	}
+
+	if (Instances->FreeInstances.Num())
+	{
+		Record.InstanceIndex = Instances->FreeInstances.Pop(false);
+		Instances->Component->UpdateInstanceTransform(Record.InstanceIndex, Record.GetTransform(), true, true, true);
+	}
+	else
+	{
+		Record.InstanceIndex = Instances->Component->AddInstanceWorldSpace(Record.GetTransform());
+	}
+
+	Record.InstanceMesh = Mesh;
+}
+
+void APickupManager::RemoveInstance(FPickupRecord& Record)
+{
+	if (Record.InstanceIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	if (FPickupMeshInstances* Instances = MeshInstances.Find(Record.InstanceMesh))
+	{
+		// Shrunk to nothing where it was, so the component's bounds don't grow to include wherever hidden instances would otherwise go
+		const FTransform HiddenTransform(Record.Rotation, Record.Location, FVector::ZeroVector);
+
+		Instances->Component->UpdateInstanceTransform(Record.InstanceIndex, HiddenTransform, true, true, true);
+		Instances->FreeInstances.Add(Record.InstanceIndex);
+	}
+
+	Record.InstanceMesh = nullptr;
+	Record.InstanceIndex = INDEX_NONE;
+}
+
+void APickupManager::GetInstanceStats(int32& OutNumComponents, int32& OutNumInstances, int32& OutNumFreeInstances) const
+{
+	OutNumComponents = MeshInstances.Num();
+	OutNumInstances = 0;
+	OutNumFreeInstances = 0;
+
+	for (const TPair<UStaticMesh*, FPickupMeshInstances>& Instances : MeshInstances)
+	{
+		OutNumInstances += Instances.Value.Component->GetInstanceCount();
+		OutNumFreeInstances += Instances.Value.FreeInstances.Num();
+	}
+}
+
+int32 APickupManager::GetNumRecords() const
+{
+	int32 NumRecords = 0;
+
+	for (TActorIterator<APickupRecordCell> It(GetWorld()); It; ++It)
+	{
+		NumRecords += It->GetNumRecords();
+	}
+
+	return NumRecords;
+}
+
+void APickupManager::GetCellStats(int32& OutNumCells, int32& OutMaxRecordsPerCell) const
+{
+	OutNumCells = 0;
+	OutMaxRecordsPerCell = 0;
+
+	for (TActorIterator<APickupRecordCell> It(GetWorld()); It; ++It)
+	{
+		++OutNumCells;
+		OutMaxRecordsPerCell = FMath::Max(OutMaxRecordsPerCell, It->GetNumRecords());
+	}
+}
+
+SIZE_T APickupManager::GetApproximateMemoryUsage() const
+{
+	SIZE_T Bytes = CellByRecordId.GetAllocatedSize() + RecordCells.GetAllocatedSize() + NetCells.GetAllocatedSize();
+
+	for (TActorIterator<APickupRecordCell> It(GetWorld()); It; ++It)
+	{
+		Bytes += It->GetApproximateMemoryUsage();
+	}
+
+	for (const TPair<FIntVector, TArray<int32>>& Cell : RecordCells)
+	{
+		Bytes += Cell.Value.GetAllocatedSize();
+	}
+
+	for (const TPair<UStaticMesh*, FPickupMeshInstances>& Instances : MeshInstances)
+	{
+		Bytes += UHierarchicalInstancedStaticMeshComponent::StaticClass()->GetStructureSize();
+		Bytes += Instances.Value.Component->PerInstanceSMData.GetAllocatedSize();
+		Bytes += Instances.Value.FreeInstances.GetAllocatedSize();
+	}
+
+	return Bytes;
+}
+
+APickupRecordCell::APickupRecordCell()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	SetRootComponent(CreateDefaultSubobject<USceneComponent>("Root"));
+
+	// Records only change when pickups are added, taken, promoted or demoted. NetCullDistanceSquared is set by the manager
+	SetReplicates(true);
+	NetUpdateFrequency = 2.f;
+
+	PickupRecords.OwnerCell = this;
+}
+
+void APickupRecordCell::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Records can arrive before the game state does, in which case there was no manager to hand them to
+	if (!HasAuthority())
+	{
+		AddRecordsToManager();
+	}
+}
+
+void APickupRecordCell::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Clients lose the cell when they move away from it, and its records with it
+	if (!HasAuthority())
+	{
+		for (FPickupRecord& Record : PickupRecords.Records)
+		{
+			OnRecordRemoved(Record);
+		}
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void APickupRecordCell::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(APickupRecordCell, PickupRecords);
+}
+
+FPickupRecord& APickupRecordCell::AddRecord(const int32 RecordId)
+{
+	FPickupRecord& Record = PickupRecords.Records.AddDefaulted_GetRef();
+	Record.RecordId = RecordId;
+
+	RecordIndexById.Add(RecordId, PickupRecords.Records.Num() - 1);
+
+	return Record;
+}
+
+FPickupRecord* APickupRecordCell::FindRecord(const int32 RecordId)
+{
+	const int32* RecordIndex = RecordIndexById.Find(RecordId);
+	return RecordIndex ? &PickupRecords.Records[*RecordIndex] : nullptr;
+}
+
+void APickupRecordCell::MarkRecordDirty(FPickupRecord& Record)
+{
+	PickupRecords.MarkItemDirty(Record);
+}
+
+void APickupRecordCell::RemoveRecord(const int32 RecordId)
+{
+	const int32* FoundIndex = RecordIndexById.Find(RecordId);
+
+	if (!FoundIndex)
+	{
+		return;
+	}
+
+	const int32 RecordIndex = *FoundIndex;
+	TArray<FPickupRecord>& Records = PickupRecords.Records;
+
+	RecordIndexById.Remove(RecordId);
+	Records.RemoveAtSwap(RecordIndex, 1, false);
+
+	// Whatever was swapped into the removed slot needs its index fixing
+	if (Records.IsValidIndex(RecordIndex))
+	{
+		RecordIndexById.Add(Records[RecordIndex].RecordId, RecordIndex);
+	}
+
+	PickupRecords.MarkArrayDirty();
+}
+
+void APickupRecordCell::OnRecordAdded(FPickupRecord& Record)
+{
+	if (APickupManager* Manager = APickupManager::Get(this))
+	{
+		Manager->OnRecordAdded(Record);
+	}
+}
+
+void APickupRecordCell::OnRecordChanged(FPickupRecord& Record)
+{
+	if (APickupManager* Manager = APickupManager::Get(this))
+	{
+		Manager->OnRecordChanged(Record);
+	}
+}
+
+void APickupRecordCell::OnRecordRemoved(FPickupRecord& Record)
+{
+	if (APickupManager* Manager = APickupManager::Get(this))
+	{
+		Manager->OnRecordRemoved(Record);
+	}
+}
+
+void APickupRecordCell::AddRecordsToManager()
+{
+	for (FPickupRecord& Record : PickupRecords.Records)
+	{
+		OnRecordAdded(Record);
+	}
+}
+
+SIZE_T APickupRecordCell::GetApproximateMemoryUsage() const
+{
+	return PickupRecords.Records.GetAllocatedSize() + RecordIndexById.GetAllocatedSize();
+}
+
+void FPickupRecord::PreReplicatedRemove(const struct FPickupRecordArray& InArraySerializer)
+{
+	if (InArraySerializer.OwnerCell)
+	{
+		InArraySerializer.OwnerCell->OnRecordRemoved(*this);
+	}
+}
+
+void FPickupRecord::PostReplicatedAdd(const struct FPickupRecordArray& InArraySerializer)
+{
+	Rotation = FRotator(0.f, FRotator::DecompressAxisFromByte(Yaw), 0.f);
+
+	if (InArraySerializer.OwnerCell)
+	{
+		InArraySerializer.OwnerCell->OnRecordAdded(*this);
+	}
+}
+
+void FPickupRecord::PostReplicatedChange(const struct FPickupRecordArray& InArraySerializer)
+{
+	Rotation = FRotator(0.f, FRotator::DecompressAxisFromByte(Yaw), 0.f);
+
+	if (InArraySerializer.OwnerCell)
+	{
+		InArraySerializer.OwnerCell->OnRecordChanged(*this);
+	}
+}
+
+#if !UE_BUILD_SHIPPING
+// Tags the pickup actors SurvivalGame.Pickups.Spawn makes in actor mode, so Clear can find them again
+static const FName StressPickupTag(TEXT("PickupStress"));
+
+static FAutoConsoleCommandWithWorldAndArgs SpawnPickupsCommand(
+	TEXT("SurvivalGame.Pickups.Spawn"),
+	TEXT("Scatters pickups of every catalog item with a mesh around the first player, as pickup manager records or, for comparison, as pickup actors. ")
+	TEXT("Usage: SurvivalGame.Pickups.Spawn [Count=1000] [Radius=20000] [actors]. Run with -nullrhi to measure game thread time without rendering."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (!World || World->IsNetMode(NM_Client))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("SurvivalGame.Pickups.Spawn has to run on the server or in standalone."));
+			return;
+		}
+
+		const int32 Count = FMath::Max(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000, 1);
+		const float Radius = FMath::Max(Args.Num() > 1 ? FCString::Atof(*Args[1]) : 20000.f, 100.f);
+		const bool bSpawnActors = Args.Num() > 2 && Args[2] == TEXT("actors");
+
+		const UItemCatalog* Catalog = UItemCatalog::Get(World);
+		APickupManager* Manager = APickupManager::Get(World);
+
+		if (!Catalog || !Manager)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("SurvivalGame.Pickups.Spawn needs an item catalog on the game instance and a ASurvivalGameStateBase game state."));
+			return;
+		}
+
+		TArray<FItemId> ItemIds;
+
+		for (int32 i = 1; i <= Catalog->GetNumItemIds(); ++i)
+		{
+			const UItemDefinition* Definition = Catalog->GetItemDefinition(FItemId(i));
+
+			if (Definition && Definition->PickUpMesh)
+			{
+				ItemIds.Add(FItemId(i));
+			}
+		}
+
+		if (ItemIds.Num() == 0)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("No catalog items have a pickup mesh."));
+			return;
+		}
+
+		const APlayerController* PC = World->GetFirstPlayerController();
+		const FVector Centre = PC && PC->GetPawn() ? PC->GetPawn()->GetActorLocation() : FVector::ZeroVector;
+		FRandomStream Random(Count);
+
+		const double StartSeconds = FPlatformTime::Seconds();
+
+		for (int32 i = 0; i < Count; ++i)
+		{
+			const FVector Offset = FRotator(0.f, Random.FRandRange(0.f, 360.f), 0.f).Vector() * Radius * FMath::Sqrt(Random.FRand());
+			const FTransform Transform(FRotator(0.f, Random.FRandRange(0.f, 360.f), 0.f), Centre + Offset);
+			const FItemId ItemId = ItemIds[i % ItemIds.Num()];
+
+			if (bSpawnActors)
+			{
+				FActorSpawnParameters SpawnParams;
+				SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+				if (APickup* Pickup = World->SpawnActor<APickup>(APickup::StaticClass(), Transform, SpawnParams))
+				{
+					Pickup->Tags.Add(StressPickupTag);
+					Pickup->InitializePickup(ItemId, 1);
+				}
+			}
+			else
+			{
+				Manager->AddPickup(ItemId, 1, Transform);
+			}
+		}
+
+		UE_LOG(LogTemp, Log, TEXT("Spawned %d pickup %s in %.2f ms"), Count, bSpawnActors ? TEXT("actors") : TEXT("records"), (FPlatformTime::Seconds() - StartSeconds) * 1000.0);
+	}));
+
+static FAutoConsoleCommandWithWorld ClearPickupsCommand(
+	TEXT("SurvivalGame.Pickups.Clear"),
+	TEXT("Removes every pickup manager record, and every pickup actor SurvivalGame.Pickups.Spawn made."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (!World || World->IsNetMode(NM_Client))
+		{
+			return;
+		}
+
+		if (APickupManager* Manager = APickupManager::Get(World))
+		{
+			Manager->RemoveAllPickups();
+		}
+
+		for (TActorIterator<APickup> It(World); It; ++It)
+		{
+			if (It->ActorHasTag(StressPickupTag))
+			{
+				It->Destroy();
+			}
+		}
+	}));
+
+static FAutoConsoleCommandWithWorld PickupStatsCommand(
+	TEXT("SurvivalGame.Pickups.Stats"),
+	TEXT("Logs how many pickups are records, promoted and plain actors in the current world, and roughly how much memory they use. Use stat rhi for draw calls and stat unit for frame times."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (!World)
+		{
+			return;
+		}
+
+		const ASurvivalGameStateBase* GameState = World->GetGameState<ASurvivalGameStateBase>();
+		const APickupManager* Manager = GameState ? GameState->PickupManager : nullptr;
+
+		int32 NumPickupActors = 0;
+		SIZE_T PickupActorBytes = 0;
+
+		for (TActorIterator<APickup> It(World); It; ++It)
+		{
+			++NumPickupActors;
+			PickupActorBytes += It->GetClass()->GetStructureSize();
+
+			for (const UActorComponent* Component : It->GetComponents())
+			{
+				PickupActorBytes += Component->GetClass()->GetStructureSize();
+			}
+		}
+
+		UE_LOG(LogTemp, Log, TEXT("%d pickup actors, roughly %.1f KB of actors and components"), NumPickupActors, PickupActorBytes / 1024.f);
+
+		if (Manager)
+		{
+			int32 NumComponents, NumInstances, NumFreeInstances;
+			Manager->GetInstanceStats(NumComponents, NumInstances, NumFreeInstances);
+
+			int32 NumCells, MaxRecordsPerCell;
+			Manager->GetCellStats(NumCells, MaxRecordsPerCell);
+
+			UE_LOG(LogTemp, Log, TEXT("Pickup manager: %d records, %d promoted, %d instanced mesh components holding %d instances (%d free), roughly %.1f KB"),
+				Manager->GetNumRecords(), Manager->GetNumPromoted(), NumComponents, NumInstances, NumFreeInstances, Manager->GetApproximateMemoryUsage() / 1024.f);
+			UE_LOG(LogTemp, Log, TEXT("%d record cells%s, at most %d records in one"), NumCells, World->IsNetMode(NM_Client) ? TEXT(" relevant to us") : TEXT(""), MaxRecordsPerCell);
+		}
+	}));
+#endif
@@ -0,0 +1,285 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Items/ItemId.h"
+#include "Engine/NetSerialization.h"
+#include "PickupManager.generated.h"
+
+// A pickup lying in the world that isn't a full APickup actor yet
+USTRUCT()
+struct FPickupRecord : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+public:
+
+	FPickupRecord()
+	{
+		RecordId = INDEX_NONE;
+		Quantity = 0;
+		Yaw = 0;
+		bPromoted = false;
+		InstanceMesh = nullptr;
+		InstanceIndex = INDEX_NONE;
+	}
+
+	// [Server] What APickupManager::AddPickup() returned for this record
+	UPROPERTY(NotReplicated)
+	int32 RecordId;
+
+	UPROPERTY()
+	FItemId ItemId;
+
+	// [Server] Clients only need to know the quantity once they're close enough to interact, which is when the record is promoted
+	UPROPERTY(NotReplicated)
+	int32 Quantity;
+
+	UPROPERTY()
+	FVector_NetQuantize Location;
+
+	// [Server] The full rotation. Pickups only ever turn about their yaw, so clients rebuild this from Yaw when the record arrives
+	UPROPERTY(NotReplicated)
+	FRotator Rotation;
+
+	// The rotation's yaw, compressed to a byte
+	UPROPERTY()
+	uint8 Yaw;
+
+	// True while a full APickup stands in for this record, in which case there's no instance for it
+	UPROPERTY()
+	bool bPromoted;
+
+	// The instance drawing this record, if it has one. Never replicated
+	class UStaticMesh* InstanceMesh;
+	int32 InstanceIndex;
+
+	FORCEINLINE FTransform GetTransform() const { return FTransform(Rotation, Location); };
+
+	// Client side callbacks, called by the fast array when this record is replicated
+	void PreReplicatedRemove(const struct FPickupRecordArray& InArraySerializer);
+	void PostReplicatedAdd(const struct FPickupRecordArray& InArraySerializer);
+	void PostReplicatedChange(const struct FPickupRecordArray& InArraySerializer);
+};
+
+USTRUCT()
+struct FPickupRecordArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+public:
+
+	FPickupRecordArray() : OwnerCell(nullptr) {};
+
+	UPROPERTY()
+	TArray<FPickupRecord> Records;
+
+	// The cell these records belong to. Deliberately not a UPROPERTY so it isn't copied from the archetype.
+	class APickupRecordCell* OwnerCell;
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FPickupRecord, FPickupRecordArray>(Records, DeltaParms, *this);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FPickupRecordArray> : public TStructOpsTypeTraitsBase2<FPickupRecordArray>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
+
+/**
+ * The records in one part of the world. APickupManager files every record under one of these, and each is relevant only to players
+ * within its net cull distance, so clients only get the records around them, and no single fast array update has to carry more than
+ * the cell's share of them. Spawned by the manager on the server, never placed.
+ */
+UCLASS(NotPlaceable, Transient)
+class SURVIVALGAME_API APickupRecordCell : public AActor
+{
+	GENERATED_BODY()
+
+public:
+
+	APickupRecordCell();
+
+	FORCEINLINE int32 GetNumRecords() const { return PickupRecords.Records.Num(); };
+	FORCEINLINE const TArray<FPickupRecord>& GetRecords() const { return PickupRecords.Records; };
+
+	// [Server] Add a record, which the caller fills in and then passes to MarkRecordDirty()
+	FPickupRecord& AddRecord(const int32 RecordId);
+	FPickupRecord* FindRecord(const int32 RecordId);
+	void MarkRecordDirty(FPickupRecord& Record);
+	void RemoveRecord(const int32 RecordId);
+
+	// [Client] Called by records when they're replicated. Passed on to the pickup manager, which draws them
+	void OnRecordAdded(FPickupRecord& Record);
+	void OnRecordChanged(FPickupRecord& Record);
+	void OnRecordRemoved(FPickupRecord& Record);
+
+	// [Client] Hand every record to the pickup manager, for when the manager arrives after the records did
+	void AddRecordsToManager();
+
+	SIZE_T GetApproximateMemoryUsage() const;
+
+protected:
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	UPROPERTY(Replicated)
+	FPickupRecordArray PickupRecords;
+
+	// [Server] Where each record is in PickupRecords.Records
+	TMap<int32, int32> RecordIndexById;
+};
+
+/**
+ * Keeps large numbers of pickups as compact records instead of actors. Records are drawn with one hierarchical instanced static
+ * mesh per pickup mesh, and the server promotes a record to a full APickup only when a player gets within reach of it, so the
+ * thousands of pickups nobody is near cost no actors, no ticks, no interaction components and very few draw calls.
+ * When every player has moved away again the APickup is demoted back to a record. Records replicate through APickupRecordCells, so
+ * clients only get the ones near them.
+ * Records hold the item's catalog ID and quantity only, so use this for loot spawned from tables rather than items players have changed.
+ */
+UCLASS(Config = Game)
+class SURVIVALGAME_API APickupManager : public AActor
+{
+	GENERATED_BODY()
+
+public:
+
+	APickupManager();
+
+	/** Get the world's pickup manager. On the server this spawns one if there isn't one yet */
+	static APickupManager* Get(const UObject* WorldContextObject);
+
+	/** [Server] Add a pickup to the world as a record. Returns an ID for RemovePickup(), or INDEX_NONE if the item isn't in the catalog */
+	int32 AddPickup(const FItemId ItemId, const int32 Quantity, const FTransform& Transform);
+
+	/** [Server] Remove a pickup, along with its APickup if it has been promoted */
+	void RemovePickup(const int32 RecordId);
+
+	/** [Server] Remove every pickup */
+	void RemoveAllPickups();
+
+	/** How many records there are. On clients, how many have been replicated, which is only those in relevant cells */
+	int32 GetNumRecords() const;
+	FORCEINLINE int32 GetNumPromoted() const { return PromotedPickups.Num(); };
+
+	/** How many record cells there are, and the most records any one of them holds. On clients, only the relevant cells count */
+	void GetCellStats(int32& OutNumCells, int32& OutMaxRecordsPerCell) const;
+
+	/** The number of instanced mesh components, how many instances they hold in total, and how many of those are free for reuse */
+	void GetInstanceStats(int32& OutNumComponents, int32& OutNumInstances, int32& OutNumFreeInstances) const;
+
+	/** Rough bytes used by the records and instance data, for comparing against the same number of pickup actors */
+	SIZE_T GetApproximateMemoryUsage() const;
+
+	// Called by record cells when their records are replicated, and by the server when it changes them
+	void OnRecordAdded(FPickupRecord& Record);
+	void OnRecordChanged(FPickupRecord& Record);
+	void OnRecordRemoved(FPickupRecord& Record);
+
+protected:
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// The pickup actor records are promoted to
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Pickups")
+	TSubclassOf<class APickup> PickupClass;
+
+	// Records within this distance of a player are promoted to pickup actors. Should be a little more than the pickups' InteractionDistance
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Pickups")
+	float PromoteDistance;
+
+	// Promoted pickups with no player within this distance are demoted. Larger than PromoteDistance so pickups near the edge don't flip back and forth
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Pickups")
+	float DemoteDistance;
+
+	// How often, in seconds, the server looks for records to promote and pickups to demote
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Pickups")
+	float PromotionInterval;
+
+	// The size of each cell in the grid records are kept in on the server. Roughly PromoteDistance works well
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Pickups")
+	float CellSize;
+
+	// The width of the square each APickupRecordCell covers. Records are replicated a whole cell at a time
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Pickups|Replication")
+	float NetCellSize;
+
+	// Players further than this from a record cell's edge don't get its records
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Pickups|Replication")
+	float NetCullDistance;
+
+	/** The most records one APickupRecordCell holds. A crowded square gets another cell rather than going over. Keep this well under
+	net.MaxNumberOfAllowedTArrayChangesPerUpdate, 2048 by default, so a cell's first replication fits in one update */
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Pickups|Replication")
+	int32 MaxRecordsPerNetCell;
+
+	// Instances further than this from the camera aren't drawn. 0 draws them at any distance
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Pickups")
+	int32 InstanceCullDistance;
+
+	// [Server] Every record cell we've spawned. See NetCells
+	UPROPERTY(Transient)
+	TArray<APickupRecordCell*> RecordCellActors;
+
+	// [Server] The pickup actor standing in for each promoted record, by record ID
+	UPROPERTY()
+	TMap<int32, class APickup*> PromotedPickups;
+
+	void UpdatePromotions();
+
+	void PromoteRecord(FPickupRecord& Record);
+	void DemoteRecord(FPickupRecord& Record);
+
+	// A promoted pickup was destroyed by something other than us, ie taken by a player
+	UFUNCTION()
+	void OnPromotedPickupDestroyed(AActor* DestroyedActor);
+
+	FTimerHandle TimerHandle_UpdatePromotions;
+
+private:
+
+	// Every instanced mesh component draws one pickup mesh. Instances are never removed, since removing reorders the instances
+	// of a hierarchical instanced mesh. They're shrunk to nothing and kept on a free list for the next record with that mesh instead.
+	struct FPickupMeshInstances
+	{
+		class UHierarchicalInstancedStaticMeshComponent* Component;
+		TArray<int32> FreeInstances;
+	};
+
+	TMap<class UStaticMesh*, FPickupMeshInstances> MeshInstances;
+
+	// [Server] The record cell each record is in, and the records in each grid cell
+	TMap<int32, APickupRecordCell*> CellByRecordId;
+	TMap<FIntVector, TArray<int32>> RecordCells;
+
+	// [Server] The record cells covering each NetCellSize square, usually just one. Kept alive by RecordCellActors
+	TMap<FIntPoint, TArray<APickupRecordCell*>> NetCells;
+
+	int32 NextRecordId;
+
+	FIntVector GetCell(const FVector& Location) const;
+	FPickupRecord* FindRecord(const int32 RecordId);
+
+	// [Server] A record cell covering the location with room for another record, spawning one if there isn't
+	APickupRecordCell* FindOrAddNetCell(const FVector& Location);
+
+	// [Server] Send a change to a record to clients, through its cell
+	void MarkRecordDirty(FPickupRecord& Record);
+
+	void AddInstance(FPickupRecord& Record);
+	void RemoveInstance(FPickupRecord& Record);
+	void RemoveRecord(const int32 RecordId);
+};
@@ -0,0 +1,197 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "World/PickupPlacementSubsystem.h"
+#include "World/Pickup.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+UPickupPlacementSubsystem::UPickupPlacementSubsystem()
+{
+	TraceStartOffset = 50.f;
+	MaxGroundDistance = 500.f;
+
+	NumPlacements = 0;
+	NumBatches = 0;
+	NumGroundMisses = 0;
+	NumSettled = 0;
+	NumSettleTimeouts = 0;
+	PlacementSeconds = 0.0;
+}
+
+void UPickupPlacementSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &UPickupPlacementSubsystem::OnWorldPostActorTick);
+}
+
+void UPickupPlacementSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+	PendingPlacements.Empty();
+	SettlingPickups.Empty();
+
+	Super::Deinitialize();
+}
+
+UPickupPlacementSubsystem* UPickupPlacementSubsystem::Get(const UObject* WorldContextObject)
+{
+	if (UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr)
+	{
+		return World->GetSubsystem<UPickupPlacementSubsystem>();
+	}
+	return nullptr;
+}
+
+void UPickupPlacementSubsystem::RequestPlacement(class APickup* Pickup)
+{
+	if (Pickup && Pickup->HasAuthority() && !Pickup->bPlacementQueued)
+	{
+		Pickup->bPlacementQueued = true;
+		PendingPlacements.Add(Pickup);
+	}
+}
+
+void UPickupPlacementSubsystem::OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	// Drops happen during actor ticks, so by now every drop this frame is queued. Replication comes after this,
+	// so pickups placed without settling go out to clients already on the ground
+	if (World != GetWorld() || (!PendingPlacements.Num() && !SettlingPickups.Num()))
+	{
+		return;
+	}
+
+	const double StartSeconds = FPlatformTime::Seconds();
+
+	if (PendingPlacements.Num())
+	{
+		FlushPlacements();
+	}
+
+	if (SettlingPickups.Num())
+	{
+		UpdateSettling();
+	}
+
+	PlacementSeconds += FPlatformTime::Seconds() - StartSeconds;
+}
+
+void UPickupPlacementSubsystem::FlushPlacements()
+{
+	++NumBatches;
+
+	// Only static world geometry counts as ground, so pickups don't land on players or on each other
+	static const FName PlacementTraceTag(TEXT("PickupPlacement"));
+	const FCollisionQueryParams QueryParams(PlacementTraceTag, false);
+	const FCollisionObjectQueryParams ObjectQueryParams(ECC_WorldStatic);
+
+	UWorld* World = GetWorld();
+	const float WorldTime = World->GetTimeSeconds();
+
+	for (const TWeakObjectPtr<APickup>& Pending : PendingPlacements)
+	{
+		APickup* Pickup = Pending.Get();
+
+		if (!Pickup || Pickup->IsPendingKillPending())
+		{
+			continue;
+		}
+
+		Pickup->bPlacementQueued = false;
+
+		if (Pickup->IsPooled())
+		{
+			continue;
+		}
+
+		++NumPlacements;
+
+		const FVector Location = Pickup->GetActorLocation();
+		const FVector TraceStart = Location + FVector::UpVector * TraceStartOffset;
+		const FVector TraceEnd = Location - FVector::UpVector * MaxGroundDistance;
+
+		FHitResult GroundHit;
+
+		if (World->LineTraceSingleByObjectType(GroundHit, TraceStart, TraceEnd, ObjectQueryParams, QueryParams))
+		{
+			Pickup->PlaceOnGround(GroundHit);
+		}
+		else
+		{
+			++NumGroundMisses;
+		}
+
+		if (Pickup->StartSettling())
+		{
+			FSettlingPickup& Settling = SettlingPickups.AddDefaulted_GetRef();
+			Settling.Pickup = Pickup;
+			Settling.ReuseCount = Pickup->ReuseCount;
+			Settling.EndTime = WorldTime + Pickup->MaxSettleTime;
+		}
+		else
+		{
+			Pickup->FinishPlacement();
+		}
+	}
+
+	PendingPlacements.Reset();
+}
+
+void UPickupPlacementSubsystem::UpdateSettling()
+{
+	const float WorldTime = GetWorld()->GetTimeSeconds();
+
+	for (int32 i = SettlingPickups.Num() - 1; i >= 0; --i)
+	{
+		const FSettlingPickup& Settling = SettlingPickups[i];
+		APickup* Pickup = Settling.Pickup.Get();
+
+		// Taken, pooled or reused since it started settling. Whatever happened to it since has dealt with its physics
+		if (!Pickup || Pickup->IsPendingKillPending() || Pickup->IsPooled() || Pickup->ReuseCount != Settling.ReuseCount)
+		{
+			SettlingPickups.RemoveAtSwap(i, 1, false);
+			continue;
+		}
+
+		const bool bAsleep = !Pickup->PickupMesh->IsSimulatingPhysics() || !Pickup->PickupMesh->RigidBodyIsAwake();
+
+		if (bAsleep || WorldTime >= Settling.EndTime)
+		{
+			++NumSettled;
+			NumSettleTimeouts += bAsleep ? 0 : 1;
+
+			Pickup->FinishPlacement();
+			SettlingPickups.RemoveAtSwap(i, 1, false);
+		}
+	}
+}
+
+#if !UE_BUILD_SHIPPING
+static FAutoConsoleCommandWithWorldAndArgs PickupPlacementStatsCommand(
+	TEXT("SurvivalGame.Pickups.PlacementStats"),
+	TEXT("Logs how many dropped pickups were placed on the ground, in how many batches, how many settled with physics, and the time it all took. Usage: SurvivalGame.Pickups.PlacementStats [reset]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UPickupPlacementSubsystem* Placement = World ? World->GetSubsystem<UPickupPlacementSubsystem>() : nullptr;
+
+		if (!Placement)
+		{
+			return;
+		}
+
+		if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+		{
+			Placement->NumPlacements = Placement->NumBatches = Placement->NumGroundMisses = Placement->NumSettled = Placement->NumSettleTimeouts = 0;
+			Placement->PlacementSeconds = 0.0;
+			return;
+		}
+
+		const int32 NumPlacements = FMath::Max(Placement->NumPlacements, 1);
+
+		UE_LOG(LogTemp, Log, TEXT("Pickup placement: %d placed in %d batches (%.1f per batch), %d found no ground. %d settled with physics, %d timed out, %d settling now. %.3f ms per pickup"),
+			Placement->NumPlacements, Placement->NumBatches, (float)Placement->NumPlacements / FMath::Max(Placement->NumBatches, 1), Placement->NumGroundMisses,
+			Placement->NumSettled, Placement->NumSettleTimeouts, Placement->GetNumSettling(), Placement->PlacementSeconds * 1000.0 / NumPlacements);
+	}));
+#endif
@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "PickupPlacementSubsystem.generated.h"
+
+/**
+ * [Server] Puts dropped pickups on the ground. Pickups dropped during a frame are queued, and once actors have ticked they're all traced
+ * down to the ground in one go and tilted to match it. Pickups with bSettleWithPhysics then simulate until they come to rest.
+ * Either way the pickup ends up not simulating, not ticking and dormant, with its final transform sent to clients once.
+ * Clients never trace, they just move the pickup to where the server put it.
+ */
+UCLASS(Config = Game)
+class SURVIVALGAME_API UPickupPlacementSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	UPickupPlacementSubsystem();
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/** Get the pickup placement subsystem for the world the given object is in */
+	static UPickupPlacementSubsystem* Get(const UObject* WorldContextObject);
+
+	/** [Server] Queue a pickup to be placed on the ground at the end of this frame */
+	void RequestPlacement(class APickup* Pickup);
+
+	FORCEINLINE int32 GetNumSettling() const { return SettlingPickups.Num(); };
+
+	// How many pickups were placed, in how many batches, and how many of their traces found no ground
+	int32 NumPlacements;
+	int32 NumBatches;
+	int32 NumGroundMisses;
+
+	// How many pickups settled with physics, and how many of those were still moving when MaxSettleTime ran out
+	int32 NumSettled;
+	int32 NumSettleTimeouts;
+
+	// Time spent placing pickups and checking on settling ones, in seconds
+	double PlacementSeconds;
+
+protected:
+
+	// How far above a pickup the ground trace starts, so pickups dropped slightly into a slope still find it
+	UPROPERTY(Config)
+	float TraceStartOffset;
+
+	// How far below a pickup to look for ground. Pickups with no ground within this stay where they were dropped
+	UPROPERTY(Config)
+	float MaxGroundDistance;
+
+private:
+
+	// Pickups waiting to be placed. Each is only in here once, see APickup::bPlacementQueued
+	TArray<TWeakObjectPtr<class APickup>> PendingPlacements;
+
+	struct FSettlingPickup
+	{
+		TWeakObjectPtr<class APickup> Pickup;
+
+		// The pickup's ReuseCount when it started settling, so a pickup that was taken and reused meanwhile isn't frozen early
+		uint8 ReuseCount;
+
+		float EndTime;
+	};
+
+	TArray<FSettlingPickup> SettlingPickups;
+
+	FDelegateHandle PostActorTickHandle;
+
+	void OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+	void FlushPlacements();
+	void UpdateSettling();
+};
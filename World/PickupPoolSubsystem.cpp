@@ -0,0 +1,310 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "World/PickupPoolSubsystem.h"
+#include "World/Pickup.h"
+#include "World/PickupCleanupSubsystem.h"
+#include "Items/Item.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+UPickupPoolSubsystem::UPickupPoolSubsystem()
+{
+	bEnablePooling = true;
+	MaxPooledPickups = 64;
+	bMergeDrops = true;
+	MergeRadius = 150.f;
+
+	NumAcquired = 0;
+	NumSpawned = 0;
+	NumReleased = 0;
+	NumDestroyed = 0;
+	AcquireSeconds = 0.0;
+	NumMergeChecks = 0;
+	NumDropsAvoided = 0;
+	NumQuantityMerged = 0;
+	NumStartupPickups = 0;
+	NumLazyPickups = 0;
+	NumItemsMaterialized = 0;
+	StartupInitSeconds = 0.0;
+}
+
+void UPickupPoolSubsystem::Deinitialize()
+{
+	PooledPickups.Empty();
+	DropCells.Empty();
+
+	Super::Deinitialize();
+}
+
+UPickupPoolSubsystem* UPickupPoolSubsystem::Get(const UObject* WorldContextObject)
+{
+	if (UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr)
+	{
+		return World->GetSubsystem<UPickupPoolSubsystem>();
+	}
+	return nullptr;
+}
+
+class APickup* UPickupPoolSubsystem::AcquirePickup(TSubclassOf<class APickup> PickupClass, const FTransform& Transform, AActor* Owner, TFunctionRef<void(class APickup*)> InitializePickup)
+{
+	if (!PickupClass || GetWorld()->IsNetMode(NM_Client))
+	{
+		return nullptr;
+	}
+
+	const double StartSeconds = FPlatformTime::Seconds();
+
+	++NumAcquired;
+
+	APickup* Pickup = nullptr;
+
+	// Most recently pooled first, since it's the most likely to have finished going dormant
+	for (int32 i = PooledPickups.Num() - 1; i >= 0; --i)
+	{
+		APickup* PooledPickup = PooledPickups[i];
+
+		if (!PooledPickup || PooledPickup->IsPendingKillPending())
+		{
+			PooledPickups.RemoveAtSwap(i, 1, false);
+			continue;
+		}
+
+		if (PooledPickup->GetClass() == PickupClass)
+		{
+			PooledPickups.RemoveAtSwap(i, 1, false);
+
+			Pickup = PooledPickup;
+			Pickup->SetOwner(Owner);
+			Pickup->OnAcquiredFromPool(Transform);
+			InitializePickup(Pickup);
+			break;
+		}
+	}
+
+	if (!Pickup)
+	{
+		Pickup = GetWorld()->SpawnActorDeferred<APickup>(PickupClass, Transform, Owner, nullptr, ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn);
+
+		if (Pickup)
+		{
+			++NumSpawned;
+			Pickup->bFromPool = bEnablePooling;
+
+			InitializePickup(Pickup);
+			Pickup->FinishSpawning(Transform);
+		}
+	}
+
+	if (Pickup)
+	{
+		AddDrop(Pickup);
+
+		// Nothing else ever removes dropped pickups that nobody takes
+		if (UPickupCleanupSubsystem* Cleanup = UPickupCleanupSubsystem::Get(this))
+		{
+			Cleanup->TrackPickup(Pickup);
+		}
+	}
+
+	AcquireSeconds += FPlatformTime::Seconds() - StartSeconds;
+	return Pickup;
+}
+
+void UPickupPoolSubsystem::ReleasePickup(class APickup* Pickup)
+{
+	if (!Pickup || Pickup->IsPooled() || Pickup->IsPendingKillPending())
+	{
+		return;
+	}
+
+	++NumReleased;
+
+	RemoveDrop(Pickup);
+
+	if (!bEnablePooling || PooledPickups.Num() >= MaxPooledPickups)
+	{
+		++NumDestroyed;
+		Pickup->Destroy();
+		return;
+	}
+
+	Pickup->OnReleasedToPool();
+	PooledPickups.Add(Pickup);
+}
+
+int32 UPickupPoolSubsystem::MergeIntoNearbyDrops(TSubclassOf<class UItem> ItemClass, const int32 Quantity, const FVector& Location)
+{
+	const UItem* ItemDefaults = ItemClass ? ItemClass->GetDefaultObject<UItem>() : nullptr;
+
+	if (!bMergeDrops || !ItemDefaults || !ItemDefaults->IsStackable() || Quantity <= 0)
+	{
+		return 0;
+	}
+
+	++NumMergeChecks;
+
+	UPickupCleanupSubsystem* Cleanup = UPickupCleanupSubsystem::Get(this);
+	const int32 MaxStackSize = ItemDefaults->GetMaxStackSize();
+	const float MergeRadiusSquared = FMath::Square(MergeRadius);
+	const FIntVector MinCell = GetDropCell(Location - FVector(MergeRadius));
+	const FIntVector MaxCell = GetDropCell(Location + FVector(MergeRadius));
+
+	int32 QuantityLeft = Quantity;
+
+	for (int32 X = MinCell.X; X <= MaxCell.X && QuantityLeft > 0; ++X)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y && QuantityLeft > 0; ++Y)
+		{
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z && QuantityLeft > 0; ++Z)
+			{
+				TArray<TWeakObjectPtr<APickup>>* Cell = DropCells.Find(FIntVector(X, Y, Z));
+
+				if (!Cell)
+				{
+					continue;
+				}
+
+				for (int32 i = Cell->Num() - 1; i >= 0 && QuantityLeft > 0; --i)
+				{
+					APickup* Pickup = (*Cell)[i].Get();
+
+					// Pickups that were destroyed without going back to the pool are cleaned up as we come across them
+					if (!Pickup || Pickup->IsPendingKillPending() || Pickup->IsPooled())
+					{
+						Cell->RemoveAtSwap(i, 1, false);
+						continue;
+					}
+
+					const UItem* PickupItemDefaults = Pickup->GetItemDefaults();
+
+					if (PickupItemDefaults && PickupItemDefaults->GetClass() == ItemClass && Pickup->GetQuantity() < MaxStackSize
+						&& FVector::DistSquared(Pickup->GetActorLocation(), Location) <= MergeRadiusSquared)
+					{
+						const int32 AmountAdded = Pickup->AddToStack(QuantityLeft);
+
+						// The stack is as fresh as the drop that went into it, so it isn't despawned with the items just added
+						if (AmountAdded > 0 && Cleanup)
+						{
+							Cleanup->RefreshPickup(Pickup);
+						}
+
+						QuantityLeft -= AmountAdded;
+					}
+				}
+			}
+		}
+	}
+
+	const int32 QuantityMerged = Quantity - QuantityLeft;
+
+	if (QuantityMerged > 0)
+	{
+		NumQuantityMerged += QuantityMerged;
+		NumDropsAvoided += QuantityLeft == 0 ? 1 : 0;
+	}
+
+	return QuantityMerged;
+}
+
+FIntVector UPickupPoolSubsystem::GetDropCell(const FVector& Location) const
+{
+	const float CellSize = FMath::Max(MergeRadius, 1.f);
+	return FIntVector(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize), FMath::FloorToInt(Location.Z / CellSize));
+}
+
+void UPickupPoolSubsystem::AddDrop(class APickup* Pickup)
+{
+	// A reused pickup may still be filed where it was last dropped
+	RemoveDrop(Pickup);
+
+	if (bMergeDrops)
+	{
+		Pickup->DropCell = GetDropCell(Pickup->GetActorLocation());
+		Pickup->bFiledAsDrop = true;
+		DropCells.FindOrAdd(Pickup->DropCell).Add(Pickup);
+	}
+}
+
+void UPickupPoolSubsystem::RemoveDrop(class APickup* Pickup)
+{
+	if (!Pickup->bFiledAsDrop)
+	{
+		return;
+	}
+
+	// Look in the cell we filed it under, the pickup may have been moved or settled into another one since
+	Pickup->bFiledAsDrop = false;
+
+	if (TArray<TWeakObjectPtr<APickup>>* CellDrops = DropCells.Find(Pickup->DropCell))
+	{
+		CellDrops->RemoveSingleSwap(Pickup, false);
+
+		if (CellDrops->Num() == 0)
+		{
+			DropCells.Remove(Pickup->DropCell);
+		}
+	}
+}
+
+void UPickupPoolSubsystem::UpdateDrop(class APickup* Pickup)
+{
+	if (Pickup && Pickup->bFiledAsDrop && Pickup->DropCell != GetDropCell(Pickup->GetActorLocation()))
+	{
+		AddDrop(Pickup);
+	}
+}
+
+void UPickupPoolSubsystem::SetPoolingEnabled(const bool bEnabled)
+{
+	bEnablePooling = bEnabled;
+
+	if (!bEnablePooling)
+	{
+		for (APickup* Pickup : PooledPickups)
+		{
+			if (Pickup)
+			{
+				Pickup->Destroy();
+			}
+		}
+
+		PooledPickups.Empty();
+	}
+}
+
+#if !UE_BUILD_SHIPPING
+static FAutoConsoleCommandWithWorldAndArgs PickupPoolStatsCommand(
+	TEXT("SurvivalGame.Pickups.PoolStats"),
+	TEXT("Logs how often dropped pickups were reused rather than spawned, how long getting one took, and how many drops were merged into existing pickups. Usage: SurvivalGame.Pickups.PoolStats [reset|on|off]. Use stat net to compare bandwidth."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UPickupPoolSubsystem* Pool = World ? World->GetSubsystem<UPickupPoolSubsystem>() : nullptr;
+
+		if (!Pool)
+		{
+			return;
+		}
+
+		if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+		{
+			Pool->NumAcquired = Pool->NumSpawned = Pool->NumReleased = Pool->NumDestroyed = 0;
+			Pool->NumMergeChecks = Pool->NumDropsAvoided = Pool->NumQuantityMerged = 0;
+			Pool->AcquireSeconds = 0.0;
+			return;
+		}
+
+		if (Args.Num() > 0 && (Args[0] == TEXT("on") || Args[0] == TEXT("off")))
+		{
+			Pool->SetPoolingEnabled(Args[0] == TEXT("on"));
+		}
+
+		const int32 NumAcquired = FMath::Max(Pool->NumAcquired, 1);
+
+		UE_LOG(LogTemp, Log, TEXT("Pickup pool %s: %d pooled. %d acquired, %d spawned (%.0f%% reused), %.3f ms per acquire. %d released, %d destroyed"),
+			Pool->IsPoolingEnabled() ? TEXT("on") : TEXT("off"), Pool->GetNumPooled(), Pool->NumAcquired, Pool->NumSpawned,
+			100.f * (Pool->NumAcquired - Pool->NumSpawned) / NumAcquired, Pool->AcquireSeconds * 1000.0 / NumAcquired, Pool->NumReleased, Pool->NumDestroyed);
+		UE_LOG(LogTemp, Log, TEXT("Drop merging: %d drops checked, %d merged completely so no pickup was needed, %d items added to existing pickups"),
+			Pool->NumMergeChecks, Pool->NumDropsAvoided, Pool->NumQuantityMerged);
+	}));
+#endif
@@ -0,0 +1,98 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "PickupPoolSubsystem.generated.h"
+
+/**
+ * [Server] Recycles dropped pickups instead of spawning and destroying one for every drop. A taken pickup is emptied and made dormant rather
+ * than destroyed. It stays relevant, so clients near it get the empty state, which clears its mesh, and keep the actor for when it's reused.
+ * Clients that leave its cull distance drop it like any other actor. Only pickups handed out by AcquirePickup() go back to the pool.
+ */
+UCLASS(Config = Game)
+class SURVIVALGAME_API UPickupPoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	UPickupPoolSubsystem();
+
+	virtual void Deinitialize() override;
+
+	/** Get the pickup pool for the world the given object is in */
+	static UPickupPoolSubsystem* Get(const UObject* WorldContextObject);
+
+	/** [Server] Get a pickup of the given class at the given transform, reusing a pooled one if there is one. InitializePickup is called
+	with it before it's returned. New pickups are spawned deferred and InitializePickup runs before they finish spawning, so the
+	first bunch clients get has the pickup's state in it */
+	class APickup* AcquirePickup(TSubclassOf<class APickup> PickupClass, const FTransform& Transform, AActor* Owner, TFunctionRef<void(class APickup*)> InitializePickup);
+
+	/** [Server] Take back a pickup from AcquirePickup(), or destroy it if the pool is full */
+	void ReleasePickup(class APickup* Pickup);
+
+	/** [Server] Add as much of a drop as will fit to stacks of the same item already dropped within MergeRadius. Returns how much was added,
+	so only the rest needs a new pickup. Only pickups from AcquirePickup() are merged into */
+	int32 MergeIntoNearbyDrops(TSubclassOf<class UItem> ItemClass, const int32 Quantity, const FVector& Location);
+
+	/** [Server] Move a dropped pickup to the cell it's in now, after it was placed on the ground or settled somewhere else */
+	void UpdateDrop(class APickup* Pickup);
+
+	/** Turn pooling off to compare against plain spawning. Pickups that are already pooled are destroyed */
+	void SetPoolingEnabled(const bool bEnabled);
+
+	FORCEINLINE bool IsPoolingEnabled() const { return bEnablePooling; };
+	FORCEINLINE int32 GetNumPooled() const { return PooledPickups.Num(); };
+
+	// How many pickups were asked for, and how many of those were spawned rather than reused. How many came back, and how many were destroyed because the pool was full
+	int32 NumAcquired;
+	int32 NumSpawned;
+	int32 NumReleased;
+	int32 NumDestroyed;
+
+	// Total time spent in AcquirePickup(), in seconds
+	double AcquireSeconds;
+
+	// How many drops looked for stacks to merge into, how many of those were merged completely so no pickup was spawned, and how many items were merged in total
+	int32 NumMergeChecks;
+	int32 NumDropsAvoided;
+	int32 NumQuantityMerged;
+
+	// How many map placed pickups were set up, how many of those put off creating their item, and how long setting them up took in seconds.
+	// How many items pickups created on demand. Kept here with the other pickup counts, see SurvivalGame.Pickups.ItemStats
+	int32 NumStartupPickups;
+	int32 NumLazyPickups;
+	int32 NumItemsMaterialized;
+	double StartupInitSeconds;
+
+protected:
+
+	UPROPERTY(Config)
+	bool bEnablePooling;
+
+	// The most pickups kept in the pool. Any more that are released are destroyed
+	UPROPERTY(Config)
+	int32 MaxPooledPickups;
+
+	UPROPERTY(Transient)
+	TArray<class APickup*> PooledPickups;
+
+	// Whether drops are merged into nearby stacks of the same item
+	UPROPERTY(Config)
+	bool bMergeDrops;
+
+	// How close a stack has to be to a drop to be merged into. Also the size of the cells dropped pickups are kept in
+	UPROPERTY(Config)
+	float MergeRadius;
+
+private:
+
+	// Every dropped pickup that's out in the world, by grid cell. Each pickup remembers the cell it's in, see APickup::DropCell
+	TMap<FIntVector, TArray<TWeakObjectPtr<class APickup>>> DropCells;
+
+	FIntVector GetDropCell(const FVector& Location) const;
+	void AddDrop(class APickup* Pickup);
+	void RemoveDrop(class APickup* Pickup);
+};